@@ -2,6 +2,7 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include "ArUco-OpenGL.h"
+#include "Logger.h"
 #include <windows.h>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2\calib3d.hpp>
@@ -12,54 +13,98 @@
 #include <cmath>
 #include <vector>
 #include <string>
-#include <map>
+#include <set>
+#include <cstring>
 
 
 #define PI  3.14159265358979323846
 using namespace std;
 
-float angle = 0.0f; // L'angle de rotation
-Marker sunMarker;
-Point2f sunPos = { 0.0, 0.0 };
-struct planet {
-    float speed;
-    float radius;
-    string name;
-    string textureFile;
-    GLuint textureID;
-};
-
-bool isPosOk = false;
+// Row layout of an OpenCV image for the next pixel transfer: OpenGL reads the rows with
+// the step of the image instead of expecting them padded to 4 bytes, any width is fine
+static void setUnpackLayout(const Mat& image) {
+    size_t step = image.step[0];
+    glPixelStorei(GL_UNPACK_ALIGNMENT, step % 8 == 0 ? 8 : step % 4 == 0 ? 4 : step % 2 == 0 ? 2 : 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, GLint(step / image.elemSize()));
+}
 
-map<int, planet> planets = { {141, {2.0f, 0.2f, "Earth","textures/earth.jpg",1}},
-    {217, {0.0f, 0.0f, "Sun","textures/sun.jpg",2}},
-    {144,{1.0f, 0.4f, "Jupiter","textures/jupiter.jpg",3}} };
+SimClock& ArUco::getClock() {
+    return m_Clock;
+}
 
 // Constructor
-ArUco::ArUco(string intrinFileName, float markerSize) {
+ArUco::ArUco(string intrinFileName, float markerSize) : m_Engine(intrinFileName, markerSize) {
     // Initializing attributes
     m_IntrinsicFile = intrinFileName;
-    m_MarkerSize = markerSize;
-    // read camera parameters if passed
-    m_CameraParams.readFromXMLFile(intrinFileName);
+    m_BackgroundDirty = false;
+    m_SunPos = Point2f(0, 0);
+    m_OrbitsOk = false;
+    // the built-in solar system until a scene is set
+    m_Bodies = defaultSceneConfig().bodies;
+
+    // only the markers of the scene are worth decoding
+    setMarkerWhitelist(m_Bodies.ids());
+    requestTextures();
+}
 
+RenderPath ArUco::setRenderPath(RenderPath path) {
+    return m_Spheres.setPath(path);
 }
 
-// Destructor
-ArUco::~ArUco() {}
+// Replaces the detections of the last frame, for render benchmarks and replays.
+// A black background is used until a frame is given to idle().
+void ArUco::setMarkers(const vector<Marker>& markers, Size imageSize) {
+    m_Engine.setMarkers(markers, imageSize);
+    if (m_ResizedImage.rows == 0 && m_GlWindowSize.area() > 0)
+        m_ResizedImage = Mat::zeros(m_GlWindowSize, CV_8UC3);
+}
+
+// Switches to another scene, typically after the scene file was edited
+void ArUco::setScene(const SceneConfig& config) {
+    if (!config.cameraFile.empty() && config.cameraFile != m_IntrinsicFile) {
+        m_IntrinsicFile = config.cameraFile;
+        m_Engine.readCalibration(m_IntrinsicFile);
+    }
+    if (config.markerSize > 0)
+        m_Engine.setMarkerSize(config.markerSize);
+
+    // textures already on the GPU are kept, so that bodies do not blink while
+    // the new images are decoded
+    m_Bodies = config.bodies;
+    const vector<int>& ids = m_Bodies.ids();
+    for (size_t i = 0; i < ids.size(); i++) {
+        SceneBody* body = m_Bodies.find(ids[i]);
+        map<string, unsigned int>::const_iterator it = m_Textures.find(body->textureFile);
+        body->textureID = it != m_Textures.end() ? it->second : 0;
+    }
 
-// Texture Loading Function
-void loadTexture(const char* filename, GLuint& textureID) {
-    int width, height, channels;
-    unsigned char* image = stbi_load(filename, &width, &height, &channels, STBI_rgb); // Load image
+    setMarkerWhitelist(ids);
+    requestTextures();
+}
 
-    if (!image) {
-        cerr << "Failed to load texture: " << filename << std::endl;
-        return;
+// Asks the loader thread to decode the textures of the scene
+void ArUco::requestTextures() {
+    set<string> files;
+    const vector<int>& ids = m_Bodies.ids();
+    for (size_t i = 0; i < ids.size(); i++) {
+        const string& file = m_Bodies.find(ids[i])->textureFile;
+        if (!file.empty() && files.insert(file).second)
+            m_TextureLoader.request(file);
     }
+}
 
-    glGenTextures(1, &textureID);  // Generate a texture ID
-    glBindTexture(GL_TEXTURE_2D, textureID);  // Bind the texture for use
+// Uploads at most one decoded texture per frame, so that a reload never stalls the render loop
+void ArUco::uploadPendingTexture() {
+    DecodedTexture texture;
+    if (!m_TextureLoader.take(texture))
+        return;
+
+    // a file keeps its texture name across reloads, only the content is replaced
+    GLuint textureID = m_Textures[texture.file];
+    if (textureID == 0)
+        glGenTextures(1, &textureID);
+    m_Textures[texture.file] = textureID;
+    glBindTexture(GL_TEXTURE_2D, textureID);
 
     // Set texture filtering parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -69,30 +114,91 @@ void loadTexture(const char* filename, GLuint& textureID) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-    // Upload the texture to OpenGL
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-    stbi_image_free(image);  // Free the image data after uploading to OpenGL
+    // decoded rows are tightly packed
+    glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+    setUnpackLayout(Mat(texture.height, texture.width, CV_8UC3, &texture.pixels[0]));
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texture.width, texture.height, 0, GL_RGB, GL_UNSIGNED_BYTE, &texture.pixels[0]);
+    glPopClientAttrib();
+
+    const vector<int>& ids = m_Bodies.ids();
+    for (size_t i = 0; i < ids.size(); i++) {
+        SceneBody* body = m_Bodies.find(ids[i]);
+        if (body->textureFile == texture.file)
+            body->textureID = textureID;
+    }
 }
 
-void drawTexturedSphere(float radius, int slices, int stacks) {
-    glEnable(GL_TEXTURE_2D);
-    GLUquadric* quad = gluNewQuadric();  // Create a new quadric object
-    gluQuadricTexture(quad, GL_TRUE);  // Enable texture mapping
-    gluSphere(quad, radius, slices, stacks);  // Draw the sphere
-    gluDeleteQuadric(quad);  // Delete the quadric object when done
-    glDisable(GL_TEXTURE_2D);
+// Destructor
+ArUco::~ArUco() {}
+
+// m = m * b, OpenGL (column-major) 4x4 matrices
+static void multMatrix(double m[16], const double b[16]) {
+    double r[16];
+    for (int c = 0; c < 4; c++)
+        for (int l = 0; l < 4; l++)
+            r[c * 4 + l] = m[l] * b[c * 4] + m[4 + l] * b[c * 4 + 1] + m[8 + l] * b[c * 4 + 2] + m[12 + l] * b[c * 4 + 3];
+    memcpy(m, r, sizeof(r));
 }
 
+// Same as glTranslate, glRotate (around z) and glScale, without a round trip through the GL matrix stack
+static void translateMatrix(double m[16], double x, double y, double z) {
+    double t[16] = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  x, y, z, 1 };
+    multMatrix(m, t);
+}
+
+static void rotateZMatrix(double m[16], double degrees) {
+    double c = cos(degrees * PI / 180), s = sin(degrees * PI / 180);
+    double r[16] = { c, s, 0, 0,  -s, c, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 };
+    multMatrix(m, r);
+}
+
+static void scaleMatrix(double m[16], double scale) {
+    double s[16] = { scale, 0, 0, 0,  0, scale, 0, 0,  0, 0, scale, 0,  0, 0, 0, 1 };
+    multMatrix(m, s);
+}
+
+// The intrinsics of each resolution are computed once, on first use: this only
+// prepares those of the camera resolution before the first frame
 void ArUco::resizeCameraParams(cv::Size newSize) {
-    m_CameraParams.resize(newSize);
+    m_Engine.getGeometry().intrinsics(newSize);
+}
+
+DetectionEngine& ArUco::getEngine() {
+    return m_Engine;
+}
+
+void ArUco::setMarkerWhitelist(const vector<int>& ids) {
+    m_Engine.setMarkerWhitelist(ids);
+}
+
+const vector<Marker>& ArUco::getMarkers() const {
+    return m_Engine.getMarkers();
+}
+
+float ArUco::getMarkerSize() const {
+    return m_Engine.getMarkerSize();
+}
+
+const PoseBuffer& ArUco::getPoses() const {
+    return m_Engine.getPoses();
+}
+
+void ArUco::setFrameDedup(bool enable) {
+    m_Engine.setFrameDedup(enable);
+}
+
+const FrameDedupStats& ArUco::getDedupStats() const {
+    return m_Engine.getDedupStats();
+}
+
+void ArUco::setChangeDrivenDetection(bool enable, float threshold, int refreshInterval) {
+    m_Engine.setChangeDrivenDetection(enable, threshold, refreshInterval);
 }
 
 // Detect marker and draw things
 void ArUco::doWork(Mat inputImg) {
     m_InputImage = inputImg;
-    m_GlWindowSize = m_InputImage.size();
-    m_CameraParams.resize(m_InputImage.size());
-    resize(m_GlWindowSize.width, m_GlWindowSize.height);
+    resize(m_InputImage.cols, m_InputImage.rows);
 }
 
 // Draw axis function
@@ -215,48 +321,36 @@ void ArUco::drawBox(GLfloat size, GLenum type)
     }
 }
 
-void drawPlanet(double modelview_matrix[16], Marker m_Marker, float m_MarkerSize, bool& hasSun, bool isPosOk) {
-    planet p = planets[m_Marker.id];
-
-    if (hasSun && p.name != "Sun" && isPosOk) {
-        m_Marker = sunMarker;
-    }
-
-    m_Marker.glGetModelViewMatrix(modelview_matrix);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-    // on charge cette matrice pour se placer dans le repere de ce marqueur [m] 
-    glLoadMatrixd(modelview_matrix);
+static void drawPlanet(double modelview_matrix[16], const Marker& m_Marker, const Marker& sunMarker, SceneBody& p, float m_MarkerSize,
+                       bool hasSun, bool isPosOk, SphereRenderer& spheres) {
+    // Planets orbit around the sun marker when the layout is right
+    Marker anchor = (hasSun && p.role != BODY_SUN && isPosOk) ? sunMarker : m_Marker;
 
-    loadTexture(p.textureFile.c_str(), p.textureID);//string ->const char*
-    glBindTexture(GL_TEXTURE_2D, p.textureID);
+    // on se place dans le repere de ce marqueur [m]
+    anchor.glGetModelViewMatrix(modelview_matrix);
 
     // On se deplace sur Z de la moitie du marqueur pour dessiner "sur" le plan du marqueur
-    glPushMatrix();
-
-    glTranslatef(0, 0, m_MarkerSize / 2);
+    translateMatrix(modelview_matrix, 0, 0, m_MarkerSize / 2);
     if (isPosOk && hasSun) {
-        if (p.speed != 0) {
-            angle += p.speed;
-            if (angle >= 360.0f) {
-                angle -= 360.0f;
-            }
-        }
-        glRotatef(angle, 0.0f, 0.0f, 1.0f);  // Rotate around Y-axis
-        glTranslatef(p.radius, 0.0f, 0.0f);  // Move the sphere along the X-axis by the radius
+        rotateZMatrix(modelview_matrix, p.orbitAngle);  // Rotate around Z-axis
+        translateMatrix(modelview_matrix, p.radius, 0, 0);  // Move the sphere along the X-axis by the radius
     }
+    scaleMatrix(modelview_matrix, m_MarkerSize / 2);
 
-    //drawSolidSphere(m_MarkerSize / 2, 20, 20);
-    drawTexturedSphere(m_MarkerSize / 2, 20, 20);
-
-    glPopMatrix();
+    // texture 0 (none) until the loader thread has decoded the image
+    spheres.draw(p.textureID, modelview_matrix);
 }
 
 // Drawing function
 void ArUco::drawScene() {
+    // the window changed size since the last frame
+    if (m_BackgroundDirty)
+        updateBackground();
     if (m_ResizedImage.rows == 0)
         return;
 
+    uploadPendingTexture();
+
     // On "reset" les matrices OpenGL de ModelView et de Projection
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
@@ -278,57 +372,73 @@ void ArUco::drawScene() {
     glRasterPos3f(0, m_GlWindowSize.height, -1.0f);
 
     // On "dessine" les pixels contenus dans l'image OpenCV m_ResizedImage (donc l'image de la Webcam qui nous sert de fond)
-    glDrawPixels(m_GlWindowSize.width, m_GlWindowSize.height, GL_RGB, GL_UNSIGNED_BYTE, m_ResizedImage.ptr(0));
+    glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+    setUnpackLayout(m_ResizedImage);
+    glDrawPixels(m_ResizedImage.cols, m_ResizedImage.rows, GL_RGB, GL_UNSIGNED_BYTE, m_ResizedImage.ptr(0));
+    glPopClientAttrib();
 
     // On active ensuite le depth test pour les objets 3D
     glEnable(GL_DEPTH_TEST);
 
     // On passe en mode projection pour definir la bonne projection calculee par ArUco
     glMatrixMode(GL_PROJECTION);
-    double proj_matrix[16];
-    m_CameraParams.glGetProjectionMatrix(m_ResizedImage.size(), m_GlWindowSize, proj_matrix, 0.01, 100);
+    // (recalculee seulement quand la taille de l'image ou de la fenetre change)
     glLoadIdentity();
     // on charge la matrice d'ArUco 
-    glLoadMatrixd(proj_matrix);
+    glLoadMatrixd(m_Engine.getGeometry().projection(m_Engine.getDetectionSize()));
 
     // On affiche le nombre de marqueurs (ne sert a rien)
     double modelview_matrix[16];
-    std::cout << "Number of markers: " << m_Markers.size() << std::endl;
+    const vector<Marker>& markers = m_Engine.getMarkers();
+    LOG_INFO_EVERY(1.0, "Number of markers: %u", unsigned(markers.size()));
 
     // On desactive le depth test
     glDisable(GL_DEPTH_TEST);
 
     bool hasSun = false;
 
-    // Check if we have a marker with the name "Sun"
-    for (unsigned int m = 0; m < m_Markers.size(); m++)
+    // Check if we have the marker of the sun
+    for (unsigned int m = 0; m < markers.size(); m++)
     {
-        if (planets[m_Markers[m].id].name == "Sun") {
+        const SceneBody* body = m_Bodies.find(markers[m].id);
+        if (body && body->role == BODY_SUN) {
             hasSun = true;
-            sunMarker = m_Markers[m];
-            sunPos = m_Markers[m].getCenter();
+            m_SunMarker = markers[m];
+            m_SunPos = markers[m].getCenter();
             break;
         }
     }
 
-    for (unsigned int m = 0; m < m_Markers.size(); m++)
+    // The planets must be laid out like their orbits around the sun:
+    // distances to the sun are computed once per marker, then checked in one sort
+    m_OrbitSamples.clear();
+    for (unsigned int m = 0; hasSun && m < markers.size(); m++)
     {
-        cout << "Checking marker ID: " << m_Markers[m].id << endl;
-        for (Marker marker : m_Markers) {
-            if (marker != m_Markers[m] && planets[marker.id].name != "Sun") {
-                if ((planets[m_Markers[m].id].radius > planets[marker.id].radius && norm(marker.getCenter() - sunPos) > norm(m_Markers[m].getCenter() - sunPos))
-                    || (planets[m_Markers[m].id].radius < planets[marker.id].radius && norm(marker.getCenter() - sunPos) < norm(m_Markers[m].getCenter() - sunPos)))
-                {
-                    isPosOk = false;
-
-                }
-                else {
-                    isPosOk = true;
-                }
-            }
+        const SceneBody* body = m_Bodies.find(markers[m].id);
+        if (body && body->role != BODY_SUN) {
+            OrbitSample sample;
+            sample.radius = body->radius;
+            sample.distance = float(norm(markers[m].getCenter() - m_SunPos));
+            m_OrbitSamples.push_back(sample);
         }
-        drawPlanet(modelview_matrix, m_Markers[m], m_MarkerSize, hasSun, isPosOk);
     }
+    m_OrbitsOk = checkOrbitOrdering(m_OrbitSamples);
+
+    // Orbits follow the simulation time, whatever the number of frames drawn
+    m_Bodies.updateOrbits(m_Clock.tick());
+
+    m_Spheres.begin();
+    for (unsigned int m = 0; m < markers.size(); m++)
+    {
+        // markers that are not part of the scene are not drawn
+        SceneBody* body = m_Bodies.find(markers[m].id);
+        if (!body)
+            continue;
+
+        LOG_DEBUG_EVERY(1.0, "Checking marker ID: %d", markers[m].id);
+        drawPlanet(modelview_matrix, markers[m], m_SunMarker, *body, m_Engine.getMarkerSize(), hasSun, m_OrbitsOk, m_Spheres);
+    }
+    m_Spheres.end();
 
     // Desactivation du depth test
     glDisable(GL_DEPTH_TEST);
@@ -337,55 +447,88 @@ void ArUco::drawScene() {
 
 
 // Idle function
-void ArUco::idle(Mat newImage) {
-    // Getting new image
-    m_InputImage = newImage.clone();
-
-    // Undistort image based on distorsion parameters
-    m_UndInputImage.create(m_InputImage.size(), CV_8UC3);
+void ArUco::idle(const Mat& newImage) {
+    // Same buffer as last time: previous image and markers are still valid
+    if (m_Engine.isDuplicateFrame(newImage))
+        return;
 
     //transform color that by default is BGR to RGB because windows systems do not allow reading BGR images with opengl properly
-    cv::cvtColor(m_InputImage, m_InputImage, cv::COLOR_BGR2RGB);
+    //the conversion reads the caller's frame directly, its RGB version is the only copy kept
+    cv::cvtColor(newImage, m_InputImage, cv::COLOR_BGR2RGB);
 
     //remove distorion in image ==> does not work very well (the YML file is not that of my camera)
-    //cv::undistort(m_InputImage,m_UndInputImage, m_CameraParams.CameraMatrix, m_CameraParams.Distorsion);
-    m_UndInputImage = m_InputImage.clone();
+    //m_Engine.getGeometry().undistortMaps(m_InputImage.size(), map1, map2); cv::remap(m_InputImage, m_UndInputImage, *map1, *map2, cv::INTER_LINEAR);
+    m_UndInputImage = m_InputImage;
 
     //resize the image to the size of the GL window
-    cv::resize(m_UndInputImage, m_ResizedImage, m_GlWindowSize);
+    updateBackground();
+
+    //detect markers, poses are solved afterwards for all of them at once
+    m_Engine.detect(m_ResizedImage);
+}
+
+// Idle function for non BGR frames
+void ArUco::idle(const Mat& frame, PixelFormat format) {
+    if (format == PIXEL_FORMAT_BGR) {
+        idle(frame);
+        return;
+    }
 
-    //detect markers
-    m_PPDetector.detect(m_ResizedImage, m_Markers, m_CameraParams, m_MarkerSize, false);
+    // Same buffer as last time: previous image and markers are still valid,
+    // otherwise markers are detected on the luma plane at the camera resolution
+    if (!m_Engine.process(frame, format))
+        return;
+
+    // Colour is only produced for the background
+    frameToRGB(frame, format, m_UndInputImage);
+    updateBackground();
+}
 
+// Idle function for frames in a buffer of the caller
+void ArUco::idle(const ExternalFrame& frame) {
+    // detection and the background conversion both read the pixels in place,
+    // nothing refers to them once idle() is done
+    idle(externalFrameView(frame), frame.format);
+    if (frame.release)
+        frame.release();
 }
 
 // Resize function
+// Only records the size: called from the window callback, possibly many times per
+// frame while the window is dragged, the image work waits for the next drawScene()
 void ArUco::resize(GLsizei iWidth, GLsizei iHeight) {
+    // any size is allowed: the background is drawn with the real step of its rows
+    if (m_GlWindowSize == Size(iWidth, iHeight))
+        return;
     m_GlWindowSize = Size(iWidth, iHeight);
+    m_Engine.getGeometry().setWindowSize(m_GlWindowSize);
+    m_BackgroundDirty = true;
+}
 
-    //not all sizes are allowed. OpenCv images have padding at the end of each line in these that are not aligned to 4 bytes
-    if (iWidth * 3 % 4 != 0) {
-        iWidth += iWidth * 3 % 4;//resize to avoid padding
-        resize(iWidth, m_GlWindowSize.height);
-    }
-    else {
-        //resize the image to the size of the GL window
-        if (m_UndInputImage.rows != 0)
-            cv::resize(m_UndInputImage, m_ResizedImage, m_GlWindowSize);
-    }
-
+void ArUco::updateBackground() {
+    m_BackgroundDirty = false;
+    if (m_GlWindowSize.area() == 0)
+        return;
+    if (m_UndInputImage.rows != 0)
+        cv::resize(m_UndInputImage, m_ResizedImage, m_GlWindowSize);
+    else if (m_ResizedImage.rows != 0)
+        m_ResizedImage = Mat::zeros(m_GlWindowSize, CV_8UC3);   // no frame yet (setMarkers)
 }
 
 // Test using ArUco to display a 3D cube in OpenCV
 void ArUco::draw3DCube(cv::Mat img, int markerInd) {
-    if (m_Markers.size() > markerInd) {
-        aruco::CvDrawingUtils::draw3dCube(img, m_Markers[markerInd], m_CameraParams);
+    const vector<Marker>& markers = m_Engine.getMarkers();
+    if (markers.size() > markerInd) {
+        Marker marker = markers[markerInd];
+        aruco::CvDrawingUtils::draw3dCube(img, marker, m_Engine.getGeometry().intrinsics(img.size()));
     }
 }
 
 void ArUco::draw3DAxis(cv::Mat img, int markerInd) {
-    if (m_Markers.size() > markerInd) {
-        aruco::CvDrawingUtils::draw3dAxis(img, m_Markers[markerInd], m_CameraParams);
+    const vector<Marker>& markers = m_Engine.getMarkers();
+    if (markers.size() > markerInd) {
+        Marker marker = markers[markerInd];
+        aruco::CvDrawingUtils::draw3dAxis(img, marker, m_Engine.getGeometry().intrinsics(img.size()));
     }
 
 }
\ No newline at end of file
@@ -20,27 +20,51 @@
 #include <fstream>
 #include <sstream>
 
-#include "aruco\aruco.h"
+#include "aruco/aruco.h"
+
+#include "DetectionEngine.h"
+#include "Scene.h"
+#include "SimClock.h"
+#include "SceneFile.h"
+#include "TextureLoader.h"
+#include "SphereRenderer.h"
+#include <map>
 
 
 using namespace cv;
 using namespace aruco;
 using namespace std;
 
+// OpenGL renderer of the scene: draws the camera image and the bodies on the markers
+// found by its DetectionEngine
 class ArUco {
 // Attributes
 protected:
    // Intrinsics file for the camera
    string            m_IntrinsicFile;
    
-   // Size of the marker (in meters)
-   float             m_MarkerSize;
-   
-   // The Marker Detector
-   MarkerDetector    m_PPDetector;
-   
-   // Vector of detected markers in the image
-   vector<Marker>    m_Markers;
+   // Markers and poses of the frames, the scene is drawn from its results
+   DetectionEngine   m_Engine;
+
+   // Bodies of the scene, indexed by marker ID (replaced by setScene)
+   SceneTable        m_Bodies;
+
+   // Planet markers of the frame, for the orbit layout check
+   vector<OrbitSample> m_OrbitSamples;
+   // Sun marker of the frame, the planets orbit around it when the layout is right
+   Marker            m_SunMarker;
+   Point2f           m_SunPos;
+   bool              m_OrbitsOk;
+
+   // Time base of the animation
+   SimClock          m_Clock;
+
+   // Textures decoded in the background, and their OpenGL names by file
+   TextureLoader     m_TextureLoader;
+   map<string, unsigned int> m_Textures;
+
+   // Draws the planets (immediate mode, VBO or instanced)
+   SphereRenderer    m_Spheres;
    
    // OpenCV matrices storing the images
    // Input Image
@@ -52,11 +76,10 @@ protected:
    // Resized image
    Mat               m_ResizedImage;
 
-   // Camera parameters
-   CameraParameters  m_CameraParams;
-   
    // Size of the OpenGL window size
    Size              m_GlWindowSize;
+   // Window resized since m_ResizedImage was made, it is made again before drawing
+   bool              m_BackgroundDirty;
    
 // Methods
 public:
@@ -77,19 +100,63 @@ public:
    void  drawWireCube(GLdouble size);
    void drawWireCone(GLdouble base, GLdouble height, GLint slices, GLint stacks);
 
-   void loadTexture(const char* filename);
-
    // GLUT functionnalities
    
    // Drawing function
    void  drawScene();
 
    // Idle function
-   void  idle(Mat newImage);
+   void  idle(const Mat& newImage);
+   // Idle function for frames in another pixel format: detection runs on the
+   // luma plane directly, colour is only produced for the background
+   void  idle(const Mat& frame, PixelFormat format);
+   // Idle function for frames in a buffer of the caller (any stride, no copy),
+   // released before returning
+   void  idle(const ExternalFrame& frame);
    
    // Resize function
    void  resize(GLsizei iWidth, GLsizei iHeight);
    void  resizeCameraParams(cv::Size newSize);
+
+   // Restricts decoding to the given marker IDs, an empty list accepts the whole dictionary
+   void  setMarkerWhitelist(const vector<int>& ids);
+
+   // Markers and poses of the last frame
+   const vector<Marker>& getMarkers() const;
+   float getMarkerSize() const;
+   const PoseBuffer& getPoses() const;
+
+   // Skips detection when a frame is identical to the previous one (enabled by default)
+   void  setFrameDedup(bool enable);
+   const FrameDedupStats& getDedupStats() const;
+
+   // Change driven detection for fixed cameras: markers are searched again only in the tiles
+   // whose mean changed by more than threshold grey levels, a full detection is forced every
+   // refreshInterval frames (0 never forces it)
+   void  setChangeDrivenDetection(bool enable, float threshold = 2.0f, int refreshInterval = 30);
+
+   // Clock of the animation, a fixed step makes benchmark and replay runs deterministic
+   SimClock& getClock();
+
+   // Replaces the bodies, marker size and camera file, textures are swapped as they get decoded
+   void  setScene(const SceneConfig& config);
+
+   // Path used to draw the planets, needs a current context; returns the path actually in use
+   RenderPath setRenderPath(RenderPath path);
+
+   // Replaces the markers of the last frame (render benchmarks, replays); imageSize is the
+   // size of the image their corners refer to
+   void  setMarkers(const vector<Marker>& markers, Size imageSize);
+
+   // Detection part, usable on its own (no OpenGL)
+   DetectionEngine& getEngine();
+protected:
+   // Scales the current frame to the window for the background
+   void  updateBackground();
+
+   // Textures of the scene: decoded in the background, uploaded one per frame
+   void  requestTextures();
+   void  uploadPendingTexture();
    
    // Test using ArUco to display a 3D cube in OpenCV
    void  draw3DCube(cv::Mat img, int markerInd=0);
@@ -0,0 +1,541 @@
+//
+//  BatchCli.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "BatchCli.h"
+#include "DetectionEngine.h"
+#include "FrameSource.h"
+#include "PosePublisher.h"
+#include "PoseShm.h"
+#include "SceneFile.h"
+#include "SessionRecorder.h"
+#include "SessionReplay.h"
+#include "SimClock.h"
+#include "ThreadPool.h"
+#include "Logger.h"
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/videoio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <thread>
+
+using namespace std;
+
+struct BatchOptions {
+   vector<string> inputs;
+   // directory of the tracks, next to each input when empty
+   string      outputDir;
+   bool        binary;
+   string      sceneFile;
+   string      cameraFile;
+   float       markerSize;
+   string      dictionary;
+   // detection threads (0: one per core), inputs decoded at once (0: as many), frames per task
+   int         threads;
+   int         files;
+   int         chunk;
+
+   BatchOptions() : binary(false), sceneFile("scene.yml"), markerSize(0), dictionary("ARUCO_MIP_36h12"),
+                    threads(0), files(0), chunk(4) {}
+};
+
+// Images of a directory, in name order, read as grey levels
+class ImageListSource : public FrameSource {
+public:
+   ImageListSource() : m_Next(0) {}
+
+   bool open(const string& directory) {
+      static const char* extensions[] = { ".png", ".jpg", ".jpeg", ".bmp", ".tif", ".tiff", ".pgm", ".ppm" };
+      vector<string> files;
+      cv::glob(directory + "/*", files, false);
+      for (size_t f = 0; f < files.size(); f++) {
+         string name = files[f];
+         size_t dot = name.rfind('.');
+         if (dot == string::npos)
+            continue;
+         string extension = name.substr(dot);
+         transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+         for (size_t e = 0; e < sizeof(extensions) / sizeof(extensions[0]); e++)
+            if (extension == extensions[e])
+               m_Files.push_back(name);
+      }
+      sort(m_Files.begin(), m_Files.end());
+      return !m_Files.empty();
+   }
+
+   size_t      frameCount() const { return m_Files.size(); }
+
+   bool        isOpened() const { return !m_Files.empty(); }
+   cv::Size    frameSize() const { return m_Size; }
+
+   bool read(cv::Mat& frame, int64_t& timestampNs) {
+      while (m_Next < m_Files.size()) {
+         frame = cv::imread(m_Files[m_Next++], cv::IMREAD_GRAYSCALE);
+         if (!frame.empty()) {
+            m_Size = frame.size();
+            timestampNs = 0;
+            return true;
+         }
+         LOG_WARNING("Cannot read the image %s", m_Files[m_Next - 1].c_str());
+      }
+      return false;
+   }
+
+private:
+   vector<string> m_Files;
+   size_t      m_Next;
+   cv::Size    m_Size;
+};
+
+// Frames of a video file, stamped with their position in the video
+class VideoFileSource : public FrameSource {
+public:
+   bool        open(const string& file) { return m_Capture.open(file); }
+   size_t      frameCount() const { return size_t(max(0.0, m_Capture.get(cv::CAP_PROP_FRAME_COUNT))); }
+
+   bool        isOpened() const { return m_Capture.isOpened(); }
+   cv::Size    frameSize() const {
+      return cv::Size(int(m_Capture.get(cv::CAP_PROP_FRAME_WIDTH)), int(m_Capture.get(cv::CAP_PROP_FRAME_HEIGHT)));
+   }
+
+   bool read(cv::Mat& frame, int64_t& timestampNs) {
+      // a new buffer each time: the previous frames are still waiting for detection
+      frame.release();
+      if (!m_Capture.read(frame) || frame.empty())
+         return false;
+      timestampNs = int64_t(m_Capture.get(cv::CAP_PROP_POS_MSEC) * 1e6);
+      return true;
+   }
+
+   void        release() { m_Capture.release(); }
+
+private:
+   cv::VideoCapture m_Capture;
+};
+
+struct BatchInputFrame {
+   cv::Mat     image;
+   PixelFormat format;
+   uint64_t    index;
+   int64_t     timestampNs;
+};
+
+struct BatchOutputFrame {
+   uint64_t    index;
+   int64_t     timestampNs;
+   vector<PoseShmMarker> markers;
+};
+
+// Track of one input. Chunks are detected in any order and written in frame order: a
+// chunk that completes early waits in 'ready' until the chunks before it are written.
+struct BatchTrack {
+   string      input;
+   string      output;
+   FILE*       file;
+   bool        binary;
+
+   mutex       trackMutex;
+   condition_variable idle;
+   map<uint64_t, vector<BatchOutputFrame> > ready;
+   uint64_t    nextChunk;
+   int         inFlight;
+   bool        failed;
+
+   BatchTrack() : file(NULL), binary(false), nextChunk(0), inFlight(0), failed(false) {}
+};
+
+// Frames decoded but not detected yet, over all the inputs: bounds the memory held by
+// readers that decode faster than the detection keeps up
+class FrameBudget {
+public:
+   explicit FrameBudget(int frames) : m_Available(frames) {}
+
+   void acquire(int frames) {
+      unique_lock<mutex> lock(m_Mutex);
+      m_Freed.wait(lock, [this, frames] { return m_Available >= frames; });
+      m_Available -= frames;
+   }
+
+   void release(int frames) {
+      {
+         lock_guard<mutex> lock(m_Mutex);
+         m_Available += frames;
+      }
+      m_Freed.notify_all();
+   }
+
+private:
+   mutex       m_Mutex;
+   condition_variable m_Freed;
+   int         m_Available;
+};
+
+static bool isDirectory(const string& path) {
+   struct stat st;
+   return stat(path.c_str(), &st) == 0 && (st.st_mode & S_IFMT) == S_IFDIR;
+}
+
+static bool isSessionFile(const string& path) {
+   FILE* file = fopen(path.c_str(), "rb");
+   if (!file)
+      return false;
+   uint32_t magic = 0;
+   bool session = fread(&magic, sizeof(magic), 1, file) == 1 && magic == SESSION_FILE_MAGIC;
+   fclose(file);
+   return session;
+}
+
+// Track file of an input: its name without extension, in outputDir or next to it
+static string trackFileName(const string& input, const BatchOptions& options) {
+   string path = input;
+   while (path.size() > 1 && (path.back() == '/' || path.back() == '\\'))
+      path.pop_back();
+   size_t slash = path.find_last_of("/\\");
+   string directory = slash == string::npos ? "" : path.substr(0, slash + 1);
+   string name = slash == string::npos ? path : path.substr(slash + 1);
+   size_t dot = name.rfind('.');
+   if (dot != string::npos && dot > 0 && !isDirectory(input))
+      name = name.substr(0, dot);
+   if (!options.outputDir.empty())
+      directory = options.outputDir + "/";
+   return directory + name + (options.binary ? ".track" : ".csv");
+}
+
+class BatchRun {
+public:
+   BatchRun(const BatchOptions& options, const aruco::CameraParameters& calibration)
+      : m_Options(options), m_Pool(options.threads),
+        m_Budget(max(options.chunk, 4 * options.chunk * m_Pool.size())) {
+      m_NextInput = 0;
+      m_FilesDone = m_FilesFailed = 0;
+      m_FramesRead = m_FramesDone = m_FramesTotal = m_Markers = 0;
+      m_LastReport = 0;
+      // one engine per worker, a chunk is detected by a single worker
+      m_Engines.resize(m_Pool.size());
+      for (size_t e = 0; e < m_Engines.size(); e++) {
+         m_Engines[e].reset(new DetectionEngine("", options.markerSize));
+         m_Engines[e]->setDictionary(options.dictionary);
+         // a worker gets chunks of any input in any order, and recorded frames are clean:
+         // two frames matching on the sampled bytes of the fingerprint may still differ
+         m_Engines[e]->setFrameDedup(false);
+         if (calibration.isValid())
+            m_Engines[e]->setCalibration(calibration);
+      }
+   }
+
+   int run() {
+      int readers = int(m_Options.inputs.size());
+      if (m_Options.files > 0)
+         readers = min(readers, m_Options.files);
+      else
+         readers = min(readers, m_Pool.size());
+      printf("%u inputs, %d detection threads, %d inputs decoded at once, %d frames per task\n",
+             unsigned(m_Options.inputs.size()), m_Pool.size(), readers, m_Options.chunk);
+
+      int64_t start = monotonicNanoseconds();
+      vector<thread> threads;
+      for (int r = 0; r < readers; r++)
+         threads.push_back(thread(&BatchRun::readInputs, this));
+
+      // Progress once per second until every input is written
+      size_t inputs = m_Options.inputs.size();
+      while (m_FilesDone < inputs) {
+         this_thread::sleep_for(chrono::milliseconds(100));
+         int64_t now = monotonicNanoseconds();
+         if (now - m_LastReport < 1000000000 && m_FilesDone < inputs)
+            continue;
+         m_LastReport = now;
+         double elapsed = (now - start) * 1e-9;
+         printf("%6.1f s: %u/%u inputs, %llu/%llu frames, %.1f frames/s\n", elapsed,
+                unsigned(m_FilesDone), unsigned(inputs), (unsigned long long)m_FramesDone,
+                (unsigned long long)max(m_FramesTotal.load(), m_FramesRead.load()), m_FramesDone / elapsed);
+      }
+      for (size_t t = 0; t < threads.size(); t++)
+         threads[t].join();
+      m_Pool.wait();
+
+      double elapsed = (monotonicNanoseconds() - start) * 1e-9;
+      printf("%u inputs (%u failed), %llu frames, %llu markers in %.1f s: %.1f frames/s\n",
+             unsigned(inputs), unsigned(m_FilesFailed), (unsigned long long)m_FramesDone,
+             (unsigned long long)m_Markers, elapsed, m_FramesDone / elapsed);
+      return m_FilesFailed ? 1 : 0;
+   }
+
+private:
+   BatchRun(const BatchRun&);
+   BatchRun& operator=(const BatchRun&);
+
+   // Reader thread: takes the next input until there is none left
+   void readInputs() {
+      for (;;) {
+         size_t input = m_NextInput++;
+         if (input >= m_Options.inputs.size())
+            return;
+         if (!processInput(m_Options.inputs[input]))
+            m_FilesFailed++;
+         m_FilesDone++;
+      }
+   }
+
+   bool processInput(const string& input) {
+      // Frames of sessions are views over the mapping (valid until release), the other
+      // sources return a new buffer for each frame: chunks can hold them without a copy
+      unique_ptr<FrameSource> source;
+      size_t frameCount = 0;
+      if (isDirectory(input)) {
+         ImageListSource* images = new ImageListSource();
+         source.reset(images);
+         if (!images->open(input)) {
+            LOG_ERROR("No image in %s", input.c_str());
+            return false;
+         }
+         frameCount = images->frameCount();
+      }
+      else if (isSessionFile(input)) {
+         SessionReplay* replay = new SessionReplay();
+         source.reset(replay);
+         if (!replay->open(input))
+            return false;
+         frameCount = replay->frameCount();
+      }
+      else {
+         VideoFileSource* video = new VideoFileSource();
+         source.reset(video);
+         if (!video->open(input)) {
+            LOG_ERROR("Cannot open the video %s", input.c_str());
+            return false;
+         }
+         frameCount = video->frameCount();
+      }
+      m_FramesTotal += frameCount;
+
+      BatchTrack track;
+      track.input = input;
+      track.output = trackFileName(input, m_Options);
+      track.binary = m_Options.binary;
+      track.file = fopen(track.output.c_str(), m_Options.binary ? "wb" : "w");
+      if (!track.file) {
+         LOG_ERROR("Cannot write %s", track.output.c_str());
+         return false;
+      }
+
+      uint64_t chunkIndex = 0;
+      uint64_t frameIndex = 0;
+      bool headerWritten = false;
+      vector<BatchInputFrame> chunk;
+      for (bool more = true; more; ) {
+         BatchInputFrame frame;
+         more = source->read(frame.image, frame.timestampNs);
+         if (more && !frame.image.empty()) {
+            if (!headerWritten) {
+               writeHeader(track, frame.image.size());
+               headerWritten = true;
+            }
+            frame.format = source->pixelFormat(frame.image);
+            frame.index = frameIndex++;
+            chunk.push_back(frame);
+            m_FramesRead++;
+         }
+         if (chunk.empty() || (more && int(chunk.size()) < m_Options.chunk))
+            continue;
+
+         int frames = int(chunk.size());
+         m_Budget.acquire(frames);
+         {
+            lock_guard<mutex> lock(track.trackMutex);
+            track.inFlight++;
+         }
+         uint64_t index = chunkIndex++;
+         m_Pool.submit([this, &track, chunk, index] { detectChunk(track, chunk, index); });
+         chunk.clear();
+      }
+      if (!headerWritten)
+         writeHeader(track, source->frameSize());
+
+      // The chunks refer to the source and the track until they are written
+      {
+         unique_lock<mutex> lock(track.trackMutex);
+         track.idle.wait(lock, [&track] { return track.inFlight == 0; });
+      }
+      source->release();
+      if (fclose(track.file) != 0)
+         track.failed = true;
+      if (track.failed)
+         LOG_ERROR("Cannot write %s", track.output.c_str());
+      else
+         LOG_INFO("%s: %llu frames written to %s", input.c_str(), (unsigned long long)frameIndex, track.output.c_str());
+      return !track.failed;
+   }
+
+   // Pool task: markers and poses of the frames of a chunk
+   void detectChunk(BatchTrack& track, const vector<BatchInputFrame>& chunk, uint64_t chunkIndex) {
+      DetectionEngine& engine = *m_Engines[m_Pool.currentWorker()];
+      vector<BatchOutputFrame> results(chunk.size());
+      uint64_t markers = 0;
+      for (size_t f = 0; f < chunk.size(); f++) {
+         const BatchInputFrame& frame = chunk[f];
+         engine.process(frame.image, frame.format);
+         const vector<aruco::Marker>& found = engine.getMarkers();
+
+         BatchOutputFrame& out = results[f];
+         out.index = frame.index;
+         out.timestampNs = frame.timestampNs;
+         out.markers.resize(found.size());
+         for (size_t m = 0; m < found.size(); m++)
+            toPoseShmMarker(found[m], out.markers[m]);
+         markers += found.size();
+      }
+      m_Budget.release(int(chunk.size()));
+      m_FramesDone += chunk.size();
+      m_Markers += markers;
+
+      lock_guard<mutex> lock(track.trackMutex);
+      track.ready[chunkIndex].swap(results);
+      while (!track.ready.empty() && track.ready.begin()->first == track.nextChunk) {
+         writeFrames(track, track.ready.begin()->second);
+         track.ready.erase(track.ready.begin());
+         track.nextChunk++;
+      }
+      if (--track.inFlight == 0)
+         track.idle.notify_all();
+   }
+
+   void writeHeader(BatchTrack& track, cv::Size size) {
+      if (track.binary) {
+         BatchTrackHeader header;
+         memset(&header, 0, sizeof(header));
+         header.magic = BATCH_TRACK_MAGIC;
+         header.version = BATCH_TRACK_VERSION;
+         header.width = size.width;
+         header.height = size.height;
+         header.markerSize = m_Engines[0]->getGeometry().isValid() ? m_Options.markerSize : 0;
+         if (fwrite(&header, sizeof(header), 1, track.file) != 1)
+            track.failed = true;
+      }
+      else
+         fprintf(track.file, "frame,timestamp_ns,id,x0,y0,x1,y1,x2,y2,x3,y3,rx,ry,rz,tx,ty,tz\n");
+   }
+
+   // Binary tracks have a record for every frame, CSV tracks a row for every marker
+   void writeFrames(BatchTrack& track, const vector<BatchOutputFrame>& frames) {
+      for (size_t f = 0; f < frames.size(); f++) {
+         const BatchOutputFrame& frame = frames[f];
+         if (track.binary) {
+            BatchTrackFrame record;
+            record.frameIndex = frame.index;
+            record.timestampNs = frame.timestampNs;
+            record.markerCount = uint32_t(frame.markers.size());
+            record.reserved = 0;
+            if (fwrite(&record, sizeof(record), 1, track.file) != 1 ||
+                (!frame.markers.empty() &&
+                 fwrite(&frame.markers[0], sizeof(PoseShmMarker), frame.markers.size(), track.file) != frame.markers.size()))
+               track.failed = true;
+            continue;
+         }
+         for (size_t m = 0; m < frame.markers.size(); m++) {
+            const PoseShmMarker& marker = frame.markers[m];
+            fprintf(track.file, "%llu,%lld,%d", (unsigned long long)frame.index, (long long)frame.timestampNs, marker.id);
+            for (int k = 0; k < 8; k++)
+               fprintf(track.file, ",%.2f", marker.corners[k]);
+            for (int k = 0; k < 3; k++)
+               fprintf(track.file, ",%.6f", marker.rvec[k]);
+            for (int k = 0; k < 3; k++)
+               fprintf(track.file, ",%.6f", marker.tvec[k]);
+            fputc('\n', track.file);
+         }
+      }
+   }
+
+   const BatchOptions& m_Options;
+   ThreadPool        m_Pool;
+   FrameBudget       m_Budget;
+   vector<unique_ptr<DetectionEngine> > m_Engines;
+
+   atomic<size_t>    m_NextInput;
+   atomic<size_t>    m_FilesDone;
+   atomic<size_t>    m_FilesFailed;
+   atomic<uint64_t>  m_FramesRead;
+   atomic<uint64_t>  m_FramesDone;
+   atomic<uint64_t>  m_FramesTotal;
+   atomic<uint64_t>  m_Markers;
+   int64_t           m_LastReport;
+};
+
+static void printBatchUsage() {
+   printf("Usage: --batch [options] <video|image directory|session file>...\n"
+          "\t-o, --output <directory> - where the tracks are written (default: next to each input)\n"
+          "\t--format <csv|bin> - one row per marker, or a compact binary track (see BatchCli.h)\n"
+          "\t--scene <file> - camera file and marker size (default scene.yml)\n"
+          "\t--camera <file> - camera file, overrides the scene (no poses without one)\n"
+          "\t--marker-size <meters> - marker side, overrides the scene\n"
+          "\t--dictionary <name> - ArUco dictionary (default ARUCO_MIP_36h12)\n"
+          "\t--threads <n> - detection threads (default: one per core)\n"
+          "\t--files <n> - inputs decoded at once (default: as many as detection threads)\n"
+          "\t--chunk <n> - frames detected per task (default 4)\n");
+}
+
+int batchMain(int argc, char* argv[]) {
+   BatchOptions options;
+   string cameraFile;
+   float markerSize = 0;
+   for (int i = 0; i < argc; i++) {
+      if ((strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0) && i + 1 < argc)
+         options.outputDir = argv[++i];
+      else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+         options.binary = strcmp(argv[++i], "bin") == 0;
+      else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+         options.sceneFile = argv[++i];
+      else if (strcmp(argv[i], "--camera") == 0 && i + 1 < argc)
+         cameraFile = argv[++i];
+      else if (strcmp(argv[i], "--marker-size") == 0 && i + 1 < argc)
+         markerSize = float(atof(argv[++i]));
+      else if (strcmp(argv[i], "--dictionary") == 0 && i + 1 < argc)
+         options.dictionary = argv[++i];
+      else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+         options.threads = atoi(argv[++i]);
+      else if (strcmp(argv[i], "--files") == 0 && i + 1 < argc)
+         options.files = atoi(argv[++i]);
+      else if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc)
+         options.chunk = max(1, atoi(argv[++i]));
+      else if (argv[i][0] == '-') {
+         cerr << "Unknown batch option " << argv[i] << endl;
+         printBatchUsage();
+         return 1;
+      }
+      else
+         options.inputs.push_back(argv[i]);
+   }
+   if (options.inputs.empty()) {
+      printBatchUsage();
+      return 1;
+   }
+
+   // Camera and marker size of the scene unless given
+   SceneConfig scene = defaultSceneConfig();
+   if (!loadScene(options.sceneFile, scene) && cameraFile.empty())
+      cerr << "Could not load the scene " << options.sceneFile << ", using the default one" << endl;
+   options.cameraFile = cameraFile.empty() ? scene.cameraFile : cameraFile;
+   options.markerSize = markerSize > 0 ? markerSize : scene.markerSize;
+
+   aruco::CameraParameters calibration;
+   if (!options.cameraFile.empty())
+      calibration.readFromXMLFile(options.cameraFile);
+   if (!calibration.isValid())
+      LOG_WARNING("No calibration in %s, the tracks will have no poses", options.cameraFile.c_str());
+
+   BatchRun run(options, calibration);
+   return run.run();
+}
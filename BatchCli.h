@@ -0,0 +1,39 @@
+//
+//  BatchCli.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_BatchCli_h
+#define UserPerspectiveAR_BatchCli_h
+
+#include <stdint.h>
+
+// Binary pose tracks (--format bin): a BatchTrackHeader, then for every frame of the
+// input a BatchTrackFrame followed by markerCount PoseShmMarker (PoseShm.h)
+#define BATCH_TRACK_MAGIC     0x4B525442u    // "BTRK"
+#define BATCH_TRACK_VERSION   1
+
+struct BatchTrackHeader {
+   uint32_t    magic;
+   uint32_t    version;
+   int32_t     width;         // of the first frame
+   int32_t     height;
+   float       markerSize;    // meters, 0 when the poses are not solved
+   uint32_t    reserved[3];
+};
+
+struct BatchTrackFrame {
+   uint64_t    frameIndex;
+   int64_t     timestampNs;   // position in the video or recorded capture time, 0 for images
+   uint32_t    markerCount;
+   uint32_t    reserved;
+};
+
+// Offline processing of recorded videos, image directories and session files, without
+// display: the markers and poses of every frame are written to one track per input.
+// Inputs are decoded several at a time and their frames detected in chunks on all the
+// cores. argv holds the arguments following --batch; returns the process exit code.
+int batchMain(int argc, char* argv[]);
+
+#endif
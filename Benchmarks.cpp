@@ -0,0 +1,424 @@
+//
+//  Benchmarks.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "Benchmarks.h"
+#include "Scene.h"
+#include "SceneFile.h"
+#include "MarkerSynth.h"
+#include "RenderBench.h"
+#include "SessionReplay.h"
+#include "ArUco-OpenGL.h"
+#include "JpegDecode.h"
+#include "DetectionEngine.h"
+#include "ThreadPool.h"
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <opencv2/core/core.hpp>
+#include <math.h>
+#include <stdio.h>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Seconds between two tick counts
+static double elapsed(int64 start, int64 end) {
+   return double(end - start) / cv::getTickFrequency();
+}
+
+// A planet marker as drawScene() sees it
+struct BenchMarker {
+   cv::Point2f    center;
+   float          radius;
+};
+
+// The pair scan drawScene() used to do: every marker against every other one
+static bool pairScanOrdering(const vector<BenchMarker>& markers, const cv::Point2f& sunPos) {
+   bool ok = true;
+   for (size_t m = 0; m < markers.size(); m++) {
+      for (size_t o = 0; o < markers.size(); o++) {
+         if (o == m)
+            continue;
+         double dm = cv::norm(markers[m].center - sunPos);
+         double dother = cv::norm(markers[o].center - sunPos);
+         if ((markers[m].radius > markers[o].radius && dother > dm) || (markers[m].radius < markers[o].radius && dother < dm))
+            ok = false;
+      }
+   }
+   return ok;
+}
+
+static bool sortedOrdering(const vector<BenchMarker>& markers, const cv::Point2f& sunPos, vector<OrbitSample>& samples) {
+   samples.clear();
+   for (size_t m = 0; m < markers.size(); m++) {
+      OrbitSample sample;
+      sample.radius = markers[m].radius;
+      sample.distance = float(cv::norm(markers[m].center - sunPos));
+      samples.push_back(sample);
+   }
+   return checkOrbitOrdering(samples);
+}
+
+static int benchOrdering() {
+   const int counts[] = { 10, 20, 50, 100, 200, 500, 1000 };
+   cv::RNG rng(42);
+   cv::Point2f sunPos(640, 360);
+   vector<OrbitSample> samples;
+
+   printf("%8s %16s %16s %10s\n", "markers", "pair scan (us)", "sorted (us)", "speedup");
+   for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+      int n = counts[c];
+
+      // Half of the runs with a valid layout (distance grows with the radius), half shuffled
+      vector<vector<BenchMarker> > layouts(8);
+      for (size_t l = 0; l < layouts.size(); l++) {
+         for (int m = 0; m < n; m++) {
+            BenchMarker marker;
+            marker.radius = float(rng.uniform(1, 20)) * 0.05f;
+            float distance = (l % 2 == 0) ? marker.radius * 500.0f + rng.uniform(0.f, 10.f) : rng.uniform(0.f, 600.f);
+            float angle = rng.uniform(0.f, float(2.0 * CV_PI));
+            marker.center = sunPos + cv::Point2f(distance * cos(angle), distance * sin(angle));
+            layouts[l].push_back(marker);
+         }
+      }
+
+      // Enough repetitions for a few hundred milliseconds per method
+      int repeats = max(1, 2000000 / (n * n));
+      int mismatches = 0;
+
+      int64 start = cv::getTickCount();
+      int okPairs = 0;
+      for (int r = 0; r < repeats; r++)
+         for (size_t l = 0; l < layouts.size(); l++)
+            okPairs += pairScanOrdering(layouts[l], sunPos);
+      double pairTime = elapsed(start, cv::getTickCount());
+
+      start = cv::getTickCount();
+      int okSorted = 0;
+      for (int r = 0; r < repeats; r++)
+         for (size_t l = 0; l < layouts.size(); l++)
+            okSorted += sortedOrdering(layouts[l], sunPos, samples);
+      double sortedTime = elapsed(start, cv::getTickCount());
+
+      for (size_t l = 0; l < layouts.size(); l++)
+         mismatches += pairScanOrdering(layouts[l], sunPos) != sortedOrdering(layouts[l], sunPos, samples);
+
+      double calls = double(repeats) * layouts.size();
+      printf("%8d %16.2f %16.2f %9.1fx%s\n", n, pairTime / calls * 1e6, sortedTime / calls * 1e6,
+             pairTime / sortedTime, mismatches ? "  (results differ!)" : "");
+   }
+   return 0;
+}
+
+// Intrinsics of the scene's camera file, the synthetic frames are rendered with them
+static aruco::CameraParameters benchCamera() {
+   SceneConfig scene = defaultSceneConfig();
+   loadScene("scene.yml", scene);
+   aruco::CameraParameters camera;
+   camera.readFromXMLFile(scene.cameraFile);
+   return camera;
+}
+
+// Detects the markers of pre-rendered frames, returns the seconds per frame
+static double timeDetection(aruco::MarkerDetector& detector, const vector<cv::Mat>& frames,
+                            const vector<vector<SynthMarker> >& truths, float& recall, int& falsePositives) {
+   vector<aruco::Marker> markers;
+   recall = 0;
+   falsePositives = 0;
+   double total = 0;
+   for (size_t f = 0; f < frames.size(); f++) {
+      int64 start = cv::getTickCount();
+      detector.detect(frames[f], markers);
+      total += elapsed(start, cv::getTickCount());
+
+      int fp;
+      recall += detectionRecall(truths[f], markers, 3.0f, &fp);
+      falsePositives += fp;
+   }
+   recall /= frames.size();
+   return total / frames.size();
+}
+
+static void renderFrames(MarkerSynthesizer& synth, int count, vector<cv::Mat>& frames, vector<vector<SynthMarker> >& truths) {
+   frames.resize(count);
+   truths.resize(count);
+   for (int f = 0; f < count; f++)
+      synth.render(frames[f], truths[f]);
+}
+
+static int benchDetection() {
+   const cv::Size sizes[] = { cv::Size(640, 480), cv::Size(1280, 720), cv::Size(1920, 1080), cv::Size(3840, 2160) };
+   const char* sizeNames[] = { "VGA", "720p", "1080p", "4K" };
+   const int counts[] = { 1, 10, 50, 100, 250, 500 };
+   const int framesPerRun = 5;
+
+   aruco::CameraParameters camera = benchCamera();
+   if (!camera.isValid()) {
+      cerr << "No camera parameters for the synthetic frames" << endl;
+      return 1;
+   }
+
+   SynthOptions options;
+   aruco::MarkerDetector detector;
+   detector.setDictionary(options.dictionary);
+   vector<cv::Mat> frames;
+   vector<vector<SynthMarker> > truths;
+
+   // Marker count and resolution
+   printf("%6s %8s %12s %10s %14s %8s %6s\n", "size", "markers", "ms/frame", "fps", "markers/s", "recall", "false");
+   for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+      for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+         options.frameSize = sizes[s];
+         options.markerCount = counts[c];
+         MarkerSynthesizer synth(camera, options, 42);
+         renderFrames(synth, framesPerRun, frames, truths);
+
+         float recall;
+         int falsePositives;
+         double t = timeDetection(detector, frames, truths, recall, falsePositives);
+         printf("%6s %8d %12.2f %10.1f %14.0f %7.1f%% %6d\n", sizeNames[s], counts[c], t * 1e3, 1.0 / t,
+                counts[c] / t, recall * 100, falsePositives);
+      }
+   }
+
+   // Image degradations, 50 markers in 720p
+   struct Condition { const char* name; float blur, noise, gradient; int occluders; };
+   const Condition conditions[] = {
+      { "clean", 0, 0, 0, 0 }, { "blur 1.5", 1.5f, 0, 0, 0 }, { "noise 8", 0, 8, 0, 0 },
+      { "gradient 0.6", 0, 0, 0.6f, 0 }, { "occluders 20", 0, 0, 0, 20 }, { "all", 1.5f, 8, 0.6f, 20 }
+   };
+   printf("\n%14s %12s %8s %6s\n", "720p x 50", "ms/frame", "recall", "false");
+   for (size_t k = 0; k < sizeof(conditions) / sizeof(conditions[0]); k++) {
+      options = SynthOptions();
+      options.markerCount = 50;
+      options.blurSigma = conditions[k].blur;
+      options.noiseSigma = conditions[k].noise;
+      options.gradient = conditions[k].gradient;
+      options.occluders = conditions[k].occluders;
+      MarkerSynthesizer synth(camera, options, 7);
+      renderFrames(synth, framesPerRun, frames, truths);
+
+      float recall;
+      int falsePositives;
+      double t = timeDetection(detector, frames, truths, recall, falsePositives);
+      printf("%14s %12.2f %7.1f%% %6d\n", conditions[k].name, t * 1e3, recall * 100, falsePositives);
+   }
+   return 0;
+}
+
+// A few synthetic frames and their ground truth, written as synth_<n>.png/.csv
+static int benchSynth() {
+   aruco::CameraParameters camera = benchCamera();
+   SynthOptions options;
+   options.markerCount = 20;
+   options.blurSigma = 1.0f;
+   options.noiseSigma = 4.0f;
+   options.gradient = 0.4f;
+   options.occluders = 5;
+   MarkerSynthesizer synth(camera, options, 1);
+
+   cv::Mat frame;
+   vector<SynthMarker> truth;
+   for (int f = 0; f < 3; f++) {
+      synth.render(frame, truth);
+      char prefix[32];
+      sprintf(prefix, "synth_%d", f);
+      if (!saveSynthFrame(prefix, frame, truth)) {
+         cerr << "Could not write " << prefix << endl;
+         return 1;
+      }
+      printf("%s.png: %d markers\n", prefix, int(truth.size()));
+   }
+   return 0;
+}
+
+// Decode cost of a 1080p MJPEG frame at each JPEG scale, in colour and luma only,
+// against a full decode followed by cv::resize
+static int benchJpeg() {
+   aruco::CameraParameters camera = benchCamera();
+   SynthOptions options;
+   options.frameSize = cv::Size(1920, 1080);
+   options.markerCount = 20;
+   MarkerSynthesizer synth(camera, options, 3);
+   cv::Mat frame;
+   vector<SynthMarker> truth;
+   synth.render(frame, truth);
+
+   vector<uchar> jpeg;
+   vector<int> quality(2);
+   quality[0] = cv::IMWRITE_JPEG_QUALITY;
+   quality[1] = 90;
+   cv::imencode(".jpg", frame, jpeg, quality);
+
+   aruco::MarkerDetector detector;
+   detector.setDictionary(options.dictionary);
+   vector<aruco::Marker> markers;
+   const int runs = 50;
+   cv::Mat image, resized;
+
+   printf("1080p frame, %u KB\n%14s %10s %12s %8s\n", unsigned(jpeg.size() / 1024), "decode", "size", "ms/frame", "markers");
+   for (int luma = 0; luma < 2; luma++) {
+      for (int scale = 1; scale <= 8; scale *= 2) {
+         int64 start = cv::getTickCount();
+         for (int r = 0; r < runs; r++)
+            decodeJpeg(&jpeg[0], jpeg.size(), scale, luma != 0, image);
+         double t = elapsed(start, cv::getTickCount()) / runs;
+         detector.detect(image, markers);
+         char name[32];
+         sprintf(name, "%s 1/%d", luma ? "luma" : "colour", scale);
+         printf("%14s %5dx%-4d %12.2f %8d\n", name, image.cols, image.rows, t * 1e3, int(markers.size()));
+      }
+   }
+
+   // What the reduced decodes replace
+   int64 start = cv::getTickCount();
+   for (int r = 0; r < runs; r++) {
+      decodeJpeg(&jpeg[0], jpeg.size(), 1, false, image);
+      cv::resize(image, resized, cv::Size(480, 270));
+   }
+   printf("%14s %5dx%-4d %12.2f\n", "full + resize", 480, 270, elapsed(start, cv::getTickCount()) / runs * 1e3);
+   return 0;
+}
+
+// Frame level parallelism: detectBatch() on 1 to all the hardware threads, against the
+// same frames detected one after the other
+static int benchBatch() {
+   aruco::CameraParameters camera = benchCamera();
+   SynthOptions options;
+   options.frameSize = cv::Size(1280, 720);
+   options.markerCount = 20;
+   MarkerSynthesizer synth(camera, options, 11);
+   vector<cv::Mat> frames;
+   vector<vector<SynthMarker> > truths;
+   renderFrames(synth, 128, frames, truths);
+
+   // Every frame is different here, the duplicate check would only cost its hash
+   DetectionEngine engine("", 0.1f);
+   engine.setCalibration(camera);
+   engine.setDictionary(options.dictionary);
+   engine.setFrameDedup(false);
+
+   vector<size_t> sequential(frames.size());
+   int64 start = cv::getTickCount();
+   for (size_t f = 0; f < frames.size(); f++) {
+      engine.process(frames[f], PIXEL_FORMAT_BGR);
+      sequential[f] = engine.getMarkers().size();
+   }
+   double base = elapsed(start, cv::getTickCount());
+   printf("%u frames 720p x %d markers\n%8s %12s %10s %9s\n", unsigned(frames.size()), options.markerCount,
+          "threads", "ms/frame", "fps", "speedup");
+   printf("%8s %12.2f %10.1f %9s\n", "serial", base * 1e3 / frames.size(), frames.size() / base, "1.0x");
+
+   // powers of two, then all the hardware threads
+   int maxThreads = max(1, int(thread::hardware_concurrency()));
+   vector<int> threadCounts;
+   for (int threads = 1; threads < maxThreads; threads *= 2)
+      threadCounts.push_back(threads);
+   threadCounts.push_back(maxThreads);
+
+   vector<FrameDetection> results;
+   for (size_t k = 0; k < threadCounts.size(); k++) {
+      int threads = threadCounts[k];
+      ThreadPool pool(threads);
+      // first run creates the engines of the workers
+      engine.detectBatch(pool, frames, results);
+
+      size_t delivered = 0;
+      bool inOrder = true;
+      start = cv::getTickCount();
+      engine.detectBatch(pool, frames, results, PIXEL_FORMAT_BGR, [&](size_t index, const FrameDetection&) {
+         inOrder = inOrder && index == delivered++;
+      });
+      double t = elapsed(start, cv::getTickCount());
+
+      size_t mismatches = 0;
+      for (size_t f = 0; f < frames.size(); f++)
+         mismatches += results[f].markers.size() != sequential[f];
+      printf("%8d %12.2f %10.1f %8.1fx%s%s\n", threads, t * 1e3 / frames.size(), frames.size() / t, base / t,
+             inOrder && delivered == frames.size() ? "" : "  (out of order!)", mismatches ? "  (results differ!)" : "");
+   }
+   return 0;
+}
+
+// Replays a session as fast as possible: access to the frames alone, then detection
+static int benchReplay(const string& file) {
+   SessionReplay replay;
+   if (file.empty() || !replay.open(file)) {
+      cerr << "Usage: --bench replay <session file>" << endl;
+      return 1;
+   }
+   size_t count = replay.frameCount();
+   if (count == 0) {
+      cerr << file << " has no frames" << endl;
+      return 1;
+   }
+   cv::Size size = replay.frameSize();
+   printf("%s: %u frames of %dx%d\n", file.c_str(), unsigned(count), size.width, size.height);
+
+   // Frames only (views over the mapping for raw sessions)
+   cv::Mat frame;
+   int64_t timestamp;
+   double checksum = 0;
+   int64 start = cv::getTickCount();
+   while (replay.read(frame, timestamp))
+      if (!frame.empty())
+         checksum += frame.ptr(frame.rows / 2)[0];
+   double t = elapsed(start, cv::getTickCount());
+   printf("%20s %10.3f ms/frame %10.1f fps (%.0f)\n", "read", t * 1e3 / count, count / t, checksum);
+
+   // Frames through the detection of the application
+   SceneConfig scene = defaultSceneConfig();
+   loadScene("scene.yml", scene);
+   ArUco aruco(scene.cameraFile, scene.markerSize);
+   aruco.setScene(scene);
+   aruco.resize(size.width, size.height);
+   aruco.resizeCameraParams(size);
+   replay.seek(0);
+   size_t detected = 0, markers = 0;
+   start = cv::getTickCount();
+   while (replay.read(frame, timestamp)) {
+      if (frame.empty())
+         continue;
+      if (frame.type() == CV_8UC2)
+         aruco.idle(frame, PIXEL_FORMAT_YUYV);
+      else
+         aruco.idle(frame);
+      markers += aruco.getMarkers().size();
+      detected++;
+   }
+   t = elapsed(start, cv::getTickCount());
+   if (detected == 0) {
+      printf("%20s no frames recorded\n", "read + detect");
+      return 0;
+   }
+   printf("%20s %10.3f ms/frame %10.1f fps, %.1f markers/frame\n", "read + detect", t * 1e3 / detected,
+          detected / t, double(markers) / detected);
+   return 0;
+}
+
+int runBenchmark(const string& name, const string& argument) {
+   if (name == "ordering")
+      return benchOrdering();
+   if (name == "detection")
+      return benchDetection();
+   if (name == "synth")
+      return benchSynth();
+   if (name == "render")
+      return runRenderBenchmark();
+   if (name == "replay")
+      return benchReplay(argument);
+   if (name == "jpeg")
+      return benchJpeg();
+   if (name == "batch")
+      return benchBatch();
+
+   cerr << "Unknown benchmark: " << name << endl;
+   cerr << "Available: ordering, detection, synth, render, replay, jpeg, batch" << endl;
+   return 1;
+}
@@ -0,0 +1,25 @@
+//
+//  Benchmarks.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_Benchmarks_h
+#define UserPerspectiveAR_Benchmarks_h
+
+#include <string>
+
+// Runs a benchmark by name and prints its results, returns the process exit code.
+//    ordering  : orbit layout check, 10 to 1000 markers
+//    detection : detection of synthetic frames, 1 to 500 markers from VGA to 4K, then
+//                under blur, noise, lighting gradient and occluders (throughput and recall)
+//    synth     : writes a few synthetic frames with their ground truth (synth_<n>.png/.csv)
+//    render    : drawScene() alone with 1 to 5000 markers, legacy / VBO / instanced paths
+//    replay    : reads the session file given as argument as fast as possible, with and
+//                without detection
+//    jpeg      : decode time of a 1080p MJPEG frame at 1/1 to 1/8 scale, colour and luma
+//    batch     : DetectionEngine::detectBatch() on 1 to all the hardware threads, speedup
+//                over a serial detection and order of the results
+int runBenchmark(const std::string& name, const std::string& argument = "");
+
+#endif
@@ -0,0 +1,86 @@
+//
+//  CameraGeometry.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "CameraGeometry.h"
+
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+using namespace std;
+
+CameraGeometry::CameraGeometry() {
+}
+
+void CameraGeometry::setCalibration(const aruco::CameraParameters& calibration) {
+   m_Calibration = calibration;
+   m_Resolutions.clear();
+}
+
+bool CameraGeometry::readCalibration(const string& file) {
+   aruco::CameraParameters calibration;
+   calibration.readFromXMLFile(file);
+   setCalibration(calibration);
+   return calibration.isValid();
+}
+
+bool CameraGeometry::isValid() const {
+   return m_Calibration.isValid();
+}
+
+const aruco::CameraParameters& CameraGeometry::getCalibration() const {
+   return m_Calibration;
+}
+
+void CameraGeometry::setWindowSize(cv::Size windowSize) {
+   // projections are made again on their next use
+   m_WindowSize = windowSize;
+}
+
+CameraGeometry::Resolution& CameraGeometry::resolution(cv::Size imageSize) {
+   pair<int, int> key(imageSize.width, imageSize.height);
+   map<pair<int, int>, Resolution>::iterator found = m_Resolutions.find(key);
+   if (found != m_Resolutions.end())
+      return found->second;
+
+   // Scaled from a copy: CameraParameters share their matrices
+   Resolution& entry = m_Resolutions[key];
+   entry.camera = aruco::CameraParameters(m_Calibration.CameraMatrix.clone(), m_Calibration.Distorsion.clone(),
+                                          m_Calibration.CamSize);
+   if (entry.camera.isValid() && entry.camera.CamSize != imageSize)
+      entry.camera.resize(imageSize);
+   // no projection yet
+   entry.projectionWindow = cv::Size(-1, -1);
+   return entry;
+}
+
+const aruco::CameraParameters& CameraGeometry::intrinsics(cv::Size imageSize) {
+   return resolution(imageSize).camera;
+}
+
+const double* CameraGeometry::projection(cv::Size imageSize, double nearPlane, double farPlane) {
+   Resolution& entry = resolution(imageSize);
+   if (entry.projectionWindow != m_WindowSize || entry.projectionPlanes[0] != nearPlane ||
+       entry.projectionPlanes[1] != farPlane) {
+      if (entry.camera.isValid())
+         entry.camera.glGetProjectionMatrix(imageSize, m_WindowSize, entry.projection, nearPlane, farPlane);
+      else
+         for (int k = 0; k < 16; k++)
+            entry.projection[k] = k % 5 == 0 ? 1 : 0;
+      entry.projectionWindow = m_WindowSize;
+      entry.projectionPlanes[0] = nearPlane;
+      entry.projectionPlanes[1] = farPlane;
+   }
+   return entry.projection;
+}
+
+void CameraGeometry::undistortMaps(cv::Size imageSize, const cv::Mat*& map1, const cv::Mat*& map2) {
+   Resolution& entry = resolution(imageSize);
+   if (entry.map1.empty() && entry.camera.isValid())
+      cv::initUndistortRectifyMap(entry.camera.CameraMatrix, entry.camera.Distorsion, cv::Mat(),
+                                  entry.camera.CameraMatrix, imageSize, CV_16SC2, entry.map1, entry.map2);
+   map1 = &entry.map1;
+   map2 = &entry.map2;
+}
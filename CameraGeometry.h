@@ -0,0 +1,57 @@
+//
+//  CameraGeometry.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_CameraGeometry_h
+#define UserPerspectiveAR_CameraGeometry_h
+
+#include "aruco/aruco.h"
+
+#include <map>
+#include <utility>
+
+// Everything derived from the calibration for a given image resolution: scaled
+// intrinsics, OpenGL projection for the current window, undistortion maps.
+// Each resolution is computed once, from the calibration (scaling never accumulates),
+// and only the parts actually asked for are computed. Changing the window size only
+// marks the projections dirty.
+class CameraGeometry {
+public:
+   CameraGeometry();
+
+   // Replaces the calibration and forgets every resolution
+   void     setCalibration(const aruco::CameraParameters& calibration);
+   bool     readCalibration(const std::string& file);
+   bool     isValid() const;
+   const aruco::CameraParameters& getCalibration() const;
+
+   // Size of the OpenGL viewport the projections are made for
+   void     setWindowSize(cv::Size windowSize);
+
+   // Intrinsics for images of imageSize
+   const aruco::CameraParameters& intrinsics(cv::Size imageSize);
+   // OpenGL projection of imageSize images drawn in the window (column major)
+   const double* projection(cv::Size imageSize, double nearPlane = 0.01, double farPlane = 100);
+   // Maps for cv::remap undistorting imageSize images
+   void     undistortMaps(cv::Size imageSize, const cv::Mat*& map1, const cv::Mat*& map2);
+
+private:
+   struct Resolution {
+      aruco::CameraParameters camera;
+      // projection, valid while projectionWindow is the window size
+      cv::Size projectionWindow;
+      double   projectionPlanes[2];
+      double   projection[16];
+      cv::Mat  map1, map2;
+   };
+
+   Resolution& resolution(cv::Size imageSize);
+
+   aruco::CameraParameters m_Calibration;
+   cv::Size                m_WindowSize;
+   std::map<std::pair<int, int>, Resolution> m_Resolutions;
+};
+
+#endif
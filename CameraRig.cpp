@@ -0,0 +1,330 @@
+//
+//  CameraRig.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "CameraRig.h"
+#include "DetectionEngine.h"
+#include "FrameSource.h"
+#include "SessionReplay.h"
+#include "SimClock.h"
+#include "Logger.h"
+
+#include <opencv2/videoio.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+using namespace std;
+
+struct CameraRig::Camera {
+   int               index;
+   CameraConfig      config;
+
+   // Capture
+   cv::VideoCapture  capture;
+   unique_ptr<FrameSource> source;
+   SessionReplay*    replay;
+   thread            captureThread;
+
+   // Detection, used by one pool task at a time
+   DetectionEngine   engine;
+
+   // Hand over between the capture thread and the detection tasks
+   mutable mutex     stateMutex;
+   bool              busy;
+   cv::Mat           pending;
+   int64_t           pendingNs;
+   uint64_t          pendingIndex;
+   CameraResult      latest;
+   CameraStats       stats;
+
+   Camera() : replay(NULL), busy(false), pendingNs(0), pendingIndex(0) {}
+};
+
+bool readCameraRig(const string& file, vector<CameraConfig>& cameras, int& threads) {
+   cv::FileStorage fs(file, cv::FileStorage::READ);
+   if (!fs.isOpened())
+      return false;
+
+   cv::FileNode list = fs["cameras"];
+   if (!list.isSeq()) {
+      cerr << "Invalid camera rig " << file << ": no cameras" << endl;
+      return false;
+   }
+   threads = (int)fs["threads"];
+   cameras.clear();
+   for (int i = 0; i < (int)list.size(); i++) {
+      cv::FileNode node = list[i];
+      CameraConfig config;
+      config.source = (string)node["source"];
+      config.cameraFile = (string)node["camera"];
+      if (!node["marker_size"].empty())
+         config.markerSize = (float)node["marker_size"];
+      if (!node["dictionary"].empty())
+         config.dictionary = (string)node["dictionary"];
+      if (config.source.empty()) {
+         cerr << "Skipping camera " << i << " of " << file << ": no source" << endl;
+         continue;
+      }
+      cameras.push_back(config);
+   }
+   return !cameras.empty();
+}
+
+CameraRig::CameraRig(ThreadPool& pool) : m_Pool(pool) {
+   m_Running = false;
+}
+
+CameraRig::~CameraRig() {
+   stop();
+}
+
+bool CameraRig::addCamera(const CameraConfig& config) {
+   unique_ptr<Camera> camera(new Camera());
+   camera->index = int(m_Cameras.size());
+   camera->config = config;
+
+   // A session file, else what VideoCapture accepts (index, file, stream)
+   unique_ptr<SessionReplay> replay(new SessionReplay());
+   if (replay->open(config.source) && replay->frameCount() > 0) {
+      replay->setRealtime(true);
+      camera->replay = replay.get();
+      camera->source.reset(replay.release());
+   }
+   else {
+      bool isIndex = config.source.find_first_not_of("0123456789") == string::npos;
+      if (isIndex)
+         camera->capture.open(atoi(config.source.c_str()));
+      else
+         camera->capture.open(config.source);
+      if (!camera->capture.isOpened()) {
+         LOG_ERROR("Cannot open camera %s", config.source.c_str());
+         return false;
+      }
+      camera->source.reset(new VideoCaptureSource(camera->capture));
+   }
+
+   if (!config.cameraFile.empty() && !camera->engine.readCalibration(config.cameraFile))
+      LOG_WARNING("No calibration in %s, camera %s will have no poses", config.cameraFile.c_str(), config.source.c_str());
+   camera->engine.setMarkerSize(config.markerSize);
+   camera->engine.setDictionary(config.dictionary);
+   m_Cameras.push_back(move(camera));
+   return true;
+}
+
+void CameraRig::setResultCallback(function<void(const CameraResult&)> callback) {
+   m_Callback = callback;
+}
+
+void CameraRig::start() {
+   if (m_Running)
+      return;
+   m_Running = true;
+   for (size_t c = 0; c < m_Cameras.size(); c++)
+      m_Cameras[c]->captureThread = thread(&CameraRig::captureLoop, this, ref(*m_Cameras[c]));
+}
+
+void CameraRig::stop() {
+   m_Running = false;
+   for (size_t c = 0; c < m_Cameras.size(); c++)
+      if (m_Cameras[c]->captureThread.joinable())
+         m_Cameras[c]->captureThread.join();
+   m_Pool.wait();
+}
+
+void CameraRig::captureLoop(Camera& camera) {
+   uint64_t frameIndex = 0;
+   cv::Mat frame;
+   int64_t captureNs;
+   while (m_Running) {
+      // a new buffer each time: the previous one may still be in detection
+      frame.release();
+      if (!camera.source->read(frame, captureNs)) {
+         if (camera.replay)
+            camera.replay->seek(0);
+         else
+            this_thread::sleep_for(chrono::milliseconds(10));
+         continue;
+      }
+      // Replays give the recorded time, used for pacing only: it has another origin and
+      // starts over with each loop. Latency is measured from the moment of reading.
+      if (camera.replay)
+         captureNs = monotonicNanoseconds();
+
+      lock_guard<mutex> lock(camera.stateMutex);
+      camera.stats.captured++;
+      if (camera.busy) {
+         if (!camera.pending.empty())
+            camera.stats.dropped++;
+         camera.pending = frame;
+         camera.pendingNs = captureNs;
+         camera.pendingIndex = frameIndex++;
+         continue;
+      }
+      camera.busy = true;
+      cv::Mat job = frame;
+      uint64_t index = frameIndex++;
+      m_Pool.submit([this, &camera, job, captureNs, index] { detect(camera, job, captureNs, index); });
+   }
+}
+
+void CameraRig::detect(Camera& camera, cv::Mat frame, int64_t captureNs, uint64_t frameIndex) {
+   // Grey levels straight from the luma of YUV frames; a frame the camera handed back
+   // twice keeps the markers of the previous one
+   camera.engine.process(frame, camera.source->pixelFormat(frame));
+
+   CameraResult result;
+   result.camera = camera.index;
+   result.frameIndex = frameIndex;
+   result.captureNs = captureNs;
+   result.markers = camera.engine.getMarkers();
+   result.detectedNs = monotonicNanoseconds();
+
+   {
+      lock_guard<mutex> lock(camera.stateMutex);
+      camera.stats.detected++;
+      camera.stats.markers += result.markers.size();
+      camera.stats.latency.add(result.detectedNs - captureNs);
+      camera.latest = result;
+
+      // The newest frame that arrived meanwhile goes back through the pool, so that the
+      // other cameras get their turn
+      if (!camera.pending.empty() && m_Running) {
+         cv::Mat next = camera.pending;
+         int64_t nextNs = camera.pendingNs;
+         uint64_t nextIndex = camera.pendingIndex;
+         camera.pending.release();
+         m_Pool.submit([this, &camera, next, nextNs, nextIndex] { detect(camera, next, nextNs, nextIndex); });
+      }
+      else {
+         camera.pending.release();
+         camera.busy = false;
+      }
+   }
+
+   if (m_Callback)
+      m_Callback(result);
+}
+
+bool CameraRig::latest(int camera, CameraResult& result) const {
+   const Camera& c = *m_Cameras[camera];
+   lock_guard<mutex> lock(c.stateMutex);
+   if (c.latest.camera < 0)
+      return false;
+   result = c.latest;
+   return true;
+}
+
+CameraStats CameraRig::stats(int camera) const {
+   const Camera& c = *m_Cameras[camera];
+   lock_guard<mutex> lock(c.stateMutex);
+   return c.stats;
+}
+
+uint64_t CameraRig::detectedFrames(int camera) const {
+   const Camera& c = *m_Cameras[camera];
+   lock_guard<mutex> lock(c.stateMutex);
+   return c.stats.detected;
+}
+
+// Latency histogram
+
+LatencyHistogram::LatencyHistogram() {
+   memset(counts, 0, sizeof(counts));
+   total = 0;
+   maxNs = 0;
+}
+
+// Bucket of a latency in microseconds: the value itself below 8, then the octave and the
+// 3 bits following the leading one
+static int latencyBucket(uint64_t us) {
+   if (us < LatencyHistogram::SUB_BUCKETS)
+      return int(us);
+   int octave = 0;
+   while ((us >> (octave + 1)) != 0)
+      octave++;
+   int bucket = (octave - 2) * LatencyHistogram::SUB_BUCKETS + int((us >> (octave - 3)) & 7);
+   return min(bucket, int(LatencyHistogram::BUCKETS) - 1);
+}
+
+// Upper bound of a bucket in microseconds
+static uint64_t bucketLimit(int bucket) {
+   if (bucket < LatencyHistogram::SUB_BUCKETS)
+      return uint64_t(bucket) + 1;
+   int octave = bucket / LatencyHistogram::SUB_BUCKETS + 2;
+   uint64_t sub = bucket % LatencyHistogram::SUB_BUCKETS;
+   return (8 + sub + 1) << (octave - 3);
+}
+
+void LatencyHistogram::add(int64_t ns) {
+   ns = max<int64_t>(0, ns);
+   counts[latencyBucket(uint64_t(ns) / 1000)]++;
+   total++;
+   maxNs = max(maxNs, ns);
+}
+
+int64_t LatencyHistogram::percentile(double fraction) const {
+   if (total == 0)
+      return 0;
+   uint64_t rank = min(total - 1, uint64_t(fraction * total));
+   uint64_t seen = 0;
+   for (int b = 0; b < BUCKETS; b++) {
+      seen += counts[b];
+      if (seen > rank)
+         return min(maxNs, int64_t(bucketLimit(b) * 1000));
+   }
+   return maxNs;
+}
+
+
+int runCameraRig(const string& file, double seconds) {
+   vector<CameraConfig> configs;
+   int threads = 0;
+   if (!readCameraRig(file, configs, threads)) {
+      cerr << "Cannot read the camera rig " << file << endl;
+      return 1;
+   }
+
+   ThreadPool pool(threads);
+   CameraRig rig(pool);
+   for (size_t c = 0; c < configs.size(); c++)
+      if (!rig.addCamera(configs[c]))
+         return 1;
+   printf("%u cameras, %d detection threads, %.0f s\n", unsigned(rig.cameraCount()), pool.size(), seconds);
+
+   int64_t start = monotonicNanoseconds();
+   rig.start();
+   int64_t end = start + int64_t(seconds * 1e9);
+   for (int64_t now = start; now < end; now = monotonicNanoseconds()) {
+      this_thread::sleep_for(chrono::nanoseconds(min<int64_t>(1000000000, end - now)));
+      uint64_t detected = 0;
+      for (size_t c = 0; c < rig.cameraCount(); c++)
+         detected += rig.detectedFrames(int(c));
+      printf("%5.1f s: %.1f frames/s\n", (monotonicNanoseconds() - start) * 1e-9,
+             detected / ((monotonicNanoseconds() - start) * 1e-9));
+   }
+   rig.stop();
+   double elapsed = (monotonicNanoseconds() - start) * 1e-9;
+
+   printf("\n%6s %9s %9s %8s %8s %8s %9s %9s %9s %9s\n", "camera", "captured", "detected", "dropped", "fps",
+          "markers", "p50 ms", "p90 ms", "p99 ms", "max ms");
+   uint64_t total = 0;
+   for (size_t c = 0; c < rig.cameraCount(); c++) {
+      CameraStats stats = rig.stats(int(c));
+      total += stats.detected;
+      printf("%6u %9llu %9llu %8llu %8.1f %8.1f %9.2f %9.2f %9.2f %9.2f\n", unsigned(c),
+             (unsigned long long)stats.captured, (unsigned long long)stats.detected, (unsigned long long)stats.dropped,
+             stats.detected / elapsed, stats.detected ? double(stats.markers) / stats.detected : 0.0,
+             stats.latency.percentile(0.5) * 1e-6, stats.latency.percentile(0.9) * 1e-6,
+             stats.latency.percentile(0.99) * 1e-6, stats.latency.maxNs * 1e-6);
+   }
+   printf("total %.1f frames/s\n", total / elapsed);
+   return 0;
+}
@@ -0,0 +1,119 @@
+//
+//  CameraRig.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_CameraRig_h
+#define UserPerspectiveAR_CameraRig_h
+
+#include "aruco/aruco.h"
+#include "ThreadPool.h"
+
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One camera of the rig
+struct CameraConfig {
+   // camera index, video file or stream, or session file (replayed in a loop)
+   std::string source;
+   // calibration
+   std::string cameraFile;
+   float       markerSize;
+   std::string dictionary;
+
+   CameraConfig() : markerSize(0.1f), dictionary("ARUCO_MIP_36h12") {}
+};
+
+// Markers of one frame of one camera
+struct CameraResult {
+   int         camera;
+   uint64_t    frameIndex;
+   int64_t     captureNs;     // frame timestamp given by the source, time of reading for replays
+   int64_t     detectedNs;    // when the poses were solved (same monotonic clock)
+   std::vector<aruco::Marker> markers;
+
+   CameraResult() : camera(-1), frameIndex(0), captureNs(0), detectedNs(0) {}
+};
+
+// Distribution of latencies in buckets of logarithmic width: exact below 8 us, then
+// 8 buckets per octave (12.5% resolution) up to about 9 minutes. Its size does not depend
+// on the length of the run.
+struct LatencyHistogram {
+   enum { SUB_BUCKETS = 8, BUCKETS = 8 * 27 };
+
+   uint64_t    counts[BUCKETS];
+   uint64_t    total;
+   int64_t     maxNs;
+
+   LatencyHistogram();
+   void     add(int64_t ns);
+   // Latency below which fraction of the samples lie (upper bound of their bucket),
+   // the largest sample for 1, in nanoseconds
+   int64_t  percentile(double fraction) const;
+};
+
+struct CameraStats {
+   uint64_t    captured;
+   uint64_t    detected;
+   // frames replaced by a newer one before detection could start
+   uint64_t    dropped;
+   uint64_t    markers;
+   // capture to poses, of the detected frames
+   LatencyHistogram latency;
+
+   CameraStats() : captured(0), detected(0), dropped(0), markers(0) {}
+};
+
+// Reads the rig description: a "cameras" list of { source, camera, marker_size, dictionary }
+// and the number of detection "threads" (0: one per core)
+bool readCameraRig(const std::string& file, std::vector<CameraConfig>& cameras, int& threads);
+
+// Several cameras tracked at once. Each camera has its capture thread, detector and
+// calibration; detections run as tasks on a pool shared by all the cameras, at most one
+// per camera at a time. A camera always detects its newest frame: a frame that arrives
+// while the previous one is being detected waits, and replaces an older one waiting.
+class CameraRig {
+public:
+   explicit CameraRig(ThreadPool& pool);
+   ~CameraRig();
+
+   bool     addCamera(const CameraConfig& config);
+   size_t   cameraCount() const { return m_Cameras.size(); }
+
+   // Called on a pool thread for each detected frame, must be set before start()
+   void     setResultCallback(std::function<void(const CameraResult&)> callback);
+
+   void     start();
+   // Stops capturing and waits for the detections in progress
+   void     stop();
+
+   // Last result of a camera, false if it has none yet
+   bool     latest(int camera, CameraResult& result) const;
+   CameraStats stats(int camera) const;
+   // Frames detected so far, without copying the latencies
+   uint64_t detectedFrames(int camera) const;
+
+private:
+   CameraRig(const CameraRig&);
+   CameraRig& operator=(const CameraRig&);
+
+   struct Camera;
+
+   void     captureLoop(Camera& camera);
+   void     detect(Camera& camera, cv::Mat frame, int64_t captureNs, uint64_t frameIndex);
+
+   ThreadPool&          m_Pool;
+   std::vector<std::unique_ptr<Camera> > m_Cameras;
+   std::function<void(const CameraResult&)> m_Callback;
+   std::atomic<bool>    m_Running;
+};
+
+// Tracks the cameras of a rig file for the given time and prints the throughput and the
+// latency distribution of each camera, returns the process exit code
+int runCameraRig(const std::string& file, double seconds);
+
+#endif
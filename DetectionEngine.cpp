@@ -0,0 +1,260 @@
+//
+//  DetectionEngine.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "DetectionEngine.h"
+#include "MarkerWhitelist.h"
+#include "ThreadPool.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <condition_variable>
+#include <mutex>
+
+using namespace std;
+
+DetectionEngine::DetectionEngine(const string& cameraFile, float markerSize) {
+   m_MarkerSize = markerSize;
+   m_FrameDedup = true;
+   m_LastFingerprint = 0;
+   m_ChangeDriven = false;
+   m_ChangeThreshold = 2.0f;
+   m_RefreshInterval = 30;
+   m_FramesSinceRefresh = 0;
+   m_WorkersDirty = true;
+   if (!cameraFile.empty())
+      readCalibration(cameraFile);
+}
+
+bool DetectionEngine::readCalibration(const string& file) {
+   m_WorkersDirty = true;
+   return m_Geometry.readCalibration(file);
+}
+
+void DetectionEngine::setCalibration(const aruco::CameraParameters& calibration) {
+   m_WorkersDirty = true;
+   m_Geometry.setCalibration(calibration);
+}
+
+CameraGeometry& DetectionEngine::getGeometry() {
+   return m_Geometry;
+}
+
+void DetectionEngine::setMarkerSize(float markerSize) {
+   m_MarkerSize = markerSize;
+   m_WorkersDirty = true;
+}
+
+float DetectionEngine::getMarkerSize() const {
+   return m_MarkerSize;
+}
+
+void DetectionEngine::setDictionary(const string& dictionary) {
+   m_Detector.setDictionary(dictionary);
+   m_Whitelist.clear();
+   m_WorkersDirty = true;
+}
+
+void DetectionEngine::setMarkerWhitelist(const vector<int>& ids) {
+   m_Whitelist = ids;
+   m_WorkersDirty = true;
+   string dictionary = m_Detector.getParameters().dictionary;
+   if (ids.empty()) {
+      // back to the labeler of the whole dictionary
+      m_Detector.setDictionary(dictionary);
+      return;
+   }
+   m_Detector.setMarkerLabeler(cv::makePtr<WhitelistLabeler>(dictionary, ids));
+}
+
+void DetectionEngine::setFrameDedup(bool enable) {
+   m_FrameDedup = enable;
+   m_LastFingerprint = 0;
+}
+
+const FrameDedupStats& DetectionEngine::getDedupStats() const {
+   return m_DedupStats;
+}
+
+void DetectionEngine::setChangeDrivenDetection(bool enable, float threshold, int refreshInterval) {
+   m_ChangeDriven = enable;
+   m_ChangeThreshold = threshold;
+   m_RefreshInterval = refreshInterval;
+   m_FramesSinceRefresh = 0;
+   // next frame has nothing to be compared with and gets a full detection
+   m_TileMap.setTileSize(32);
+}
+
+bool DetectionEngine::process(const cv::Mat& frame, PixelFormat format) {
+   if (isDuplicateFrame(frame))
+      return false;
+   // The detector only needs intensity: the Y plane of YUV frames is taken as is
+   // (m_LumaBuffer only receives a copy for packed formats such as YUYV)
+   detect(format == PIXEL_FORMAT_BGR ? frame : lumaPlane(frame, format, m_LumaBuffer));
+   return true;
+}
+
+bool DetectionEngine::process(const ExternalFrame& frame) {
+   bool processed = process(externalFrameView(frame), frame.format);
+   if (frame.release)
+      frame.release();
+   return processed;
+}
+
+bool DetectionEngine::isDuplicateFrame(const cv::Mat& frame) {
+   m_DedupStats.frames++;
+   if (!m_FrameDedup)
+      return false;
+
+   int64 start = cv::getTickCount();
+   uint64_t fingerprint = frameFingerprint(frame);
+   m_DedupStats.hashTime += double(cv::getTickCount() - start) / cv::getTickFrequency();
+
+   // nothing to reuse before the first frame has been processed
+   bool duplicate = (fingerprint == m_LastFingerprint && m_DetectionSize.area() != 0);
+   m_LastFingerprint = fingerprint;
+   if (duplicate)
+      m_DedupStats.duplicates++;
+   return duplicate;
+}
+
+void DetectionEngine::detect(const cv::Mat& image) {
+   int64 start = cv::getTickCount();
+   m_DetectionSize = image.size();
+   if (m_ChangeDriven)
+      detectChanged(image);
+   else {
+      m_Detector.detect(image, m_Markers);
+      estimatePoses();
+   }
+   m_DedupStats.processTime += double(cv::getTickCount() - start) / cv::getTickFrequency();
+}
+
+void DetectionEngine::detectChanged(const cv::Mat& image) {
+   cv::Rect full(0, 0, image.cols, image.rows);
+   bool comparable = m_TileMap.update(image);
+   cv::Rect roi = m_TileMap.changedRegion(m_ChangeThreshold);
+   if (!comparable || (m_RefreshInterval > 0 && ++m_FramesSinceRefresh >= m_RefreshInterval))
+      roi = full;
+
+   // Static scene: the previous markers are still right
+   if (roi.area() == 0)
+      return;
+
+   // Markers touching the changed area are searched again entirely
+   for (size_t i = 0; i < m_Markers.size(); i++) {
+      cv::Rect box = cv::boundingRect(m_Markers[i]);
+      if ((box & roi).area() > 0)
+         roi |= box;
+   }
+   // and a margin keeps a marker entering the area from being cut
+   const int margin = 32;
+   roi = cv::Rect(roi.x - margin, roi.y - margin, roi.width + 2 * margin, roi.height + 2 * margin) & full;
+
+   if (roi.area() > full.area() / 2) {
+      m_Detector.detect(image, m_Markers);
+      m_FramesSinceRefresh = 0;
+   }
+   else {
+      image(roi).copyTo(m_RoiImage);
+      m_Detector.detect(m_RoiImage, m_RoiMarkers);
+
+      // markers outside the region are kept, those inside are replaced by the new detection
+      size_t kept = 0;
+      for (size_t i = 0; i < m_Markers.size(); i++) {
+         if (!roi.contains(cv::Point(m_Markers[i].getCenter())))
+            m_Markers[kept++] = m_Markers[i];
+      }
+      m_Markers.resize(kept);
+
+      cv::Point2f offset(float(roi.x), float(roi.y));
+      for (size_t i = 0; i < m_RoiMarkers.size(); i++) {
+         for (size_t c = 0; c < m_RoiMarkers[i].size(); c++)
+            m_RoiMarkers[i][c] += offset;
+         m_Markers.push_back(m_RoiMarkers[i]);
+      }
+   }
+   estimatePoses();
+}
+
+void DetectionEngine::estimatePoses() {
+   // the corners are expressed in the detection image, so must be the camera parameters
+   if (m_Geometry.isValid() && !m_Markers.empty())
+      m_PoseSolver.solve(m_Markers, m_Geometry.intrinsics(m_DetectionSize), m_MarkerSize, m_Poses);
+   else
+      m_Poses.count = 0;
+}
+
+void DetectionEngine::setMarkers(const vector<aruco::Marker>& markers, cv::Size imageSize) {
+   m_Markers = markers;
+   m_DetectionSize = imageSize;
+}
+
+const vector<aruco::Marker>& DetectionEngine::getMarkers() const {
+   return m_Markers;
+}
+
+const PoseBuffer& DetectionEngine::getPoses() const {
+   return m_Poses;
+}
+
+cv::Size DetectionEngine::getDetectionSize() const {
+   return m_DetectionSize;
+}
+
+void DetectionEngine::prepareWorkers(int count) {
+   if (!m_WorkersDirty && int(m_Workers.size()) == count)
+      return;
+   m_Workers.resize(count);
+   for (int w = 0; w < count; w++) {
+      if (!m_Workers[w])
+         m_Workers[w].reset(new DetectionEngine());
+      DetectionEngine& worker = *m_Workers[w];
+      worker.setCalibration(m_Geometry.getCalibration());
+      worker.setMarkerSize(m_MarkerSize);
+      worker.setDictionary(m_Detector.getParameters().dictionary);
+      if (!m_Whitelist.empty())
+         worker.setMarkerWhitelist(m_Whitelist);
+      // batch frames need not follow each other: a frame matching the one the worker did
+      // before must still be detected
+      worker.setFrameDedup(false);
+   }
+   m_WorkersDirty = false;
+}
+
+void DetectionEngine::detectBatch(ThreadPool& pool, const vector<cv::Mat>& frames, vector<FrameDetection>& results,
+                                  PixelFormat format, const function<void(size_t, const FrameDetection&)>& ordered) {
+   results.resize(frames.size());
+   if (frames.empty())
+      return;
+   prepareWorkers(pool.size());
+
+   // Reorder buffer: frames complete in any order, 'next' is the first one not delivered
+   mutex batchMutex;
+   condition_variable finished;
+   vector<char> done(frames.size(), 0);
+   size_t next = 0;
+   size_t remaining = frames.size();
+
+   for (size_t i = 0; i < frames.size(); i++) {
+      pool.submit([&, i] {
+         // a worker runs one task at a time, its engine is not shared
+         DetectionEngine& worker = *m_Workers[pool.currentWorker()];
+         worker.process(frames[i], format);
+         results[i].markers = worker.getMarkers();
+         results[i].imageSize = worker.getDetectionSize();
+
+         lock_guard<mutex> lock(batchMutex);
+         done[i] = 1;
+         if (ordered)
+            for (; next < frames.size() && done[next]; next++)
+               ordered(next, results[next]);
+         if (--remaining == 0)
+            finished.notify_all();
+      });
+   }
+
+   unique_lock<mutex> lock(batchMutex);
+   finished.wait(lock, [&remaining] { return remaining == 0; });
+}
@@ -0,0 +1,138 @@
+//
+//  DetectionEngine.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_DetectionEngine_h
+#define UserPerspectiveAR_DetectionEngine_h
+
+#include "aruco/aruco.h"
+
+#include "CameraGeometry.h"
+#include "FrameFormat.h"
+#include "FrameHash.h"
+#include "PoseBatch.h"
+#include "TileDiff.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// Markers of one frame of a batch
+struct FrameDetection {
+   std::vector<aruco::Marker> markers;
+   // size of the image their corners refer to
+   cv::Size    imageSize;
+};
+
+// Marker detection and pose estimation for a stream of frames, with no OpenGL or window
+// system dependency. The renderer (ArUco, ArUco-OpenGL.h), the batch mode and the camera
+// rig are built on it. An engine keeps the state of one stream (previous frame for the
+// duplicate check and change driven detection); engines share nothing, each can be
+// driven by its own thread.
+class DetectionEngine {
+public:
+   explicit DetectionEngine(const std::string& cameraFile = "", float markerSize = 0);
+
+   // Calibration of the camera, markers have no pose without one
+   bool     readCalibration(const std::string& file);
+   void     setCalibration(const aruco::CameraParameters& calibration);
+   CameraGeometry& getGeometry();
+
+   // Side of the markers (meters)
+   void     setMarkerSize(float markerSize);
+   float    getMarkerSize() const;
+
+   // Dictionary of the markers, accepting all of its markers again
+   void     setDictionary(const std::string& dictionary);
+   // Restricts decoding to the given marker IDs, an empty list accepts the whole dictionary
+   void     setMarkerWhitelist(const std::vector<int>& ids);
+
+   // Skips detection when a frame is identical to the previous one (enabled by default)
+   void     setFrameDedup(bool enable);
+   const FrameDedupStats& getDedupStats() const;
+
+   // Change driven detection for fixed cameras: markers are searched again only in the tiles
+   // whose mean changed by more than threshold grey levels, a full detection is forced every
+   // refreshInterval frames (0 never forces it)
+   void     setChangeDrivenDetection(bool enable, float threshold = 2.0f, int refreshInterval = 30);
+
+   // Whole processing of a camera frame: duplicate check, detection on the luma plane (BGR
+   // frames as they are) and poses. False if the frame was the same as the previous one,
+   // whose results are kept.
+   bool     process(const cv::Mat& frame, PixelFormat format);
+   // Same for a frame in a buffer of the caller: detection reads it in place, whatever its
+   // stride, and the frame is released before returning
+   bool     process(const ExternalFrame& frame);
+
+   // The steps of process(), for callers detecting in an image of their own (the renderer
+   // detects in the background image). isDuplicateFrame() counts the frame in the stats.
+   bool     isDuplicateFrame(const cv::Mat& frame);
+   void     detect(const cv::Mat& image);
+
+   // Replaces the markers of the last frame (replays, render benchmarks); imageSize is the
+   // size of the image their corners refer to
+   void     setMarkers(const std::vector<aruco::Marker>& markers, cv::Size imageSize);
+
+   // Results of the last frame
+   const std::vector<aruco::Marker>& getMarkers() const;
+   const PoseBuffer& getPoses() const;
+   // Size of the image the corners of the markers refer to
+   cv::Size getDetectionSize() const;
+
+   // Detects independent frames concurrently on the threads of pool. Each worker uses an
+   // engine of its own (detector, pose solver, scratch buffers) configured like this one,
+   // except that frames are never deduplicated nor detected by change: the frames need
+   // not follow each other. results[i] receives the markers of frames[i]. 'ordered', when given, is called for
+   // every frame in input order, as soon as the frame and all the ones before it are done.
+   // Returns when the whole batch is done: must not be called from a task of pool.
+   void     detectBatch(ThreadPool& pool, const std::vector<cv::Mat>& frames, std::vector<FrameDetection>& results,
+                        PixelFormat format = PIXEL_FORMAT_BGR,
+                        const std::function<void(size_t, const FrameDetection&)>& ordered = nullptr);
+
+private:
+   // Engines of the workers of detectBatch(), configured again after a change
+   void     prepareWorkers(int count);
+
+   // Markers searched again only where the image changed
+   void     detectChanged(const cv::Mat& image);
+   // Solves the poses of all the detected markers at once
+   void     estimatePoses();
+
+   float                      m_MarkerSize;
+   aruco::MarkerDetector      m_Detector;
+   CameraGeometry             m_Geometry;
+
+   // Results of the last frame
+   std::vector<aruco::Marker> m_Markers;
+   PoseBatchSolver            m_PoseSolver;
+   PoseBuffer                 m_Poses;
+   cv::Size                   m_DetectionSize;
+   // luma of packed YUV frames
+   cv::Mat                    m_LumaBuffer;
+
+   // Skipping the frames a stalled camera hands back twice
+   bool                       m_FrameDedup;
+   uint64_t                   m_LastFingerprint;
+   FrameDedupStats            m_DedupStats;
+
+   // Change driven detection: detection only runs where the image changed
+   bool                       m_ChangeDriven;
+   float                      m_ChangeThreshold;
+   int                        m_RefreshInterval;
+   int                        m_FramesSinceRefresh;
+   TileChangeMap              m_TileMap;
+   cv::Mat                    m_RoiImage;
+   std::vector<aruco::Marker> m_RoiMarkers;
+
+   // Allowed marker IDs, for the worker engines
+   std::vector<int>           m_Whitelist;
+   std::vector<std::unique_ptr<DetectionEngine> > m_Workers;
+   bool                       m_WorkersDirty;
+};
+
+#endif
@@ -0,0 +1,130 @@
+//
+//  FileWatcher.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "FileWatcher.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+bool fileStamp(const std::string& file, int64_t& mtime, int64_t& size) {
+#ifdef _WIN32
+   // stat() only has whole seconds, the last write time is in 100 ns units since 1601:
+   // brought back to 1970 first so that nanoseconds fit in 64 bits, as on the other systems
+   WIN32_FILE_ATTRIBUTE_DATA data;
+   if (!GetFileAttributesExA(file.c_str(), GetFileExInfoStandard, &data))
+      return false;
+   const int64_t epoch1970 = 116444736000000000LL;
+   int64_t ticks = int64_t((uint64_t(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime);
+   mtime = (ticks - epoch1970) * 100;
+   size = (int64_t(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+#else
+   struct stat st;
+   if (stat(file.c_str(), &st) != 0)
+      return false;
+#ifdef __APPLE__
+   mtime = int64_t(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+   mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+   size = int64_t(st.st_size);
+#endif
+   return true;
+}
+
+FileWatcher::FileWatcher() {
+   m_MTime = m_Size = -1;
+#ifdef __linux__
+   m_Fd = m_Watch = -1;
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+   close();
+}
+
+bool FileWatcher::open(const std::string& file) {
+   close();
+   m_File = file;
+   if (!fileStamp(file, m_MTime, m_Size))
+      m_MTime = m_Size = -1;
+
+#ifdef __linux__
+   size_t slash = file.find_last_of('/');
+   std::string dir = slash == std::string::npos ? "." : file.substr(0, slash + 1);
+   m_Name = slash == std::string::npos ? file : file.substr(slash + 1);
+
+   m_Fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+   if (m_Fd < 0)
+      return true;   // falls back on polling
+   m_Watch = inotify_add_watch(m_Fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+   if (m_Watch < 0) {
+      ::close(m_Fd);
+      m_Fd = -1;
+   }
+#endif
+   return true;
+}
+
+void FileWatcher::close() {
+#ifdef __linux__
+   if (m_Fd >= 0)
+      ::close(m_Fd);
+   m_Fd = m_Watch = -1;
+#endif
+   m_File.clear();
+}
+
+bool FileWatcher::wait(int timeoutMs) {
+   if (m_File.empty()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+      return false;
+   }
+
+#ifdef __linux__
+   if (m_Fd >= 0) {
+      pollfd pfd;
+      pfd.fd = m_Fd;
+      pfd.events = POLLIN;
+      if (poll(&pfd, 1, timeoutMs) <= 0)
+         return false;
+
+      // several events may come for one save, they are all read at once
+      bool changed = false;
+      alignas(inotify_event) char buffer[4096];
+      ssize_t len;
+      while ((len = read(m_Fd, buffer, sizeof(buffer))) > 0) {
+         for (char* p = buffer; p < buffer + len; ) {
+            const inotify_event* event = (const inotify_event*)p;
+            if (event->len > 0 && m_Name == event->name)
+               changed = true;
+            p += sizeof(inotify_event) + event->len;
+         }
+      }
+      return changed;
+   }
+#endif
+
+   // no notification available: compare the stamp of the file
+   std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+   int64_t mtime, size;
+   if (!fileStamp(m_File, mtime, size) || (mtime == m_MTime && size == m_Size))
+      return false;
+   m_MTime = mtime;
+   m_Size = size;
+   return true;
+}
@@ -0,0 +1,42 @@
+//
+//  FileWatcher.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_FileWatcher_h
+#define UserPerspectiveAR_FileWatcher_h
+
+#include <stdint.h>
+#include <string>
+
+// Modification time (nanoseconds, to the resolution of the file system) and size of a
+// file, false when it does not exist. Two writes within the same second differ.
+bool fileStamp(const std::string& file, int64_t& mtime, int64_t& size);
+
+// Tells when a file was written.
+// Uses inotify on Linux (the directory is watched, so editors that replace the file
+// are seen as well), and compares the modification time of the file elsewhere.
+class FileWatcher {
+public:
+   FileWatcher();
+   ~FileWatcher();
+
+   bool     open(const std::string& file);
+   void     close();
+
+   // Waits up to timeoutMs milliseconds, true when the file changed
+   bool     wait(int timeoutMs);
+
+private:
+   std::string m_File;
+   int64_t     m_MTime;
+   int64_t     m_Size;
+#ifdef __linux__
+   std::string m_Name;
+   int         m_Fd;
+   int         m_Watch;
+#endif
+};
+
+#endif
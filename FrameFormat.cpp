@@ -0,0 +1,70 @@
+//
+//  FrameFormat.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "FrameFormat.h"
+#include <opencv2/imgproc/imgproc.hpp>
+
+cv::Mat externalFrameView(const ExternalFrame& frame) {
+   int type = CV_8UC3;
+   int rows = frame.height;
+   switch (frame.format) {
+      case PIXEL_FORMAT_GREY: type = CV_8UC1; break;
+      case PIXEL_FORMAT_YUYV: type = CV_8UC2; break;
+      case PIXEL_FORMAT_NV12: type = CV_8UC1; rows = frame.height * 3 / 2; break;
+      case PIXEL_FORMAT_BGR:
+      default: break;
+   }
+   // a stride of 0 is Mat::AUTO_STEP, packed rows
+   return cv::Mat(rows, frame.width, type, const_cast<void*>(frame.data), frame.stride);
+}
+
+cv::Size frameImageSize(const cv::Mat& frame, PixelFormat format) {
+   if (format == PIXEL_FORMAT_NV12)
+      return cv::Size(frame.cols, frame.rows * 2 / 3);
+   return frame.size();
+}
+
+cv::Mat lumaPlane(const cv::Mat& frame, PixelFormat format, cv::Mat& lumaBuffer) {
+   switch (format) {
+      case PIXEL_FORMAT_GREY:
+         return frame;
+
+      case PIXEL_FORMAT_NV12:
+         // the Y plane is stored first, we only need a header on it
+         return frame.rowRange(0, frame.rows * 2 / 3);
+
+      case PIXEL_FORMAT_YUYV:
+         // Y is every other byte, the detector wants a contiguous plane
+         cv::extractChannel(frame, lumaBuffer, 0);
+         return lumaBuffer;
+
+      case PIXEL_FORMAT_BGR:
+      default:
+         cv::cvtColor(frame, lumaBuffer, cv::COLOR_BGR2GRAY);
+         return lumaBuffer;
+   }
+}
+
+void frameToRGB(const cv::Mat& frame, PixelFormat format, cv::Mat& rgb) {
+   switch (format) {
+      case PIXEL_FORMAT_GREY:
+         cv::cvtColor(frame, rgb, cv::COLOR_GRAY2RGB);
+         break;
+
+      case PIXEL_FORMAT_NV12:
+         cv::cvtColor(frame, rgb, cv::COLOR_YUV2RGB_NV12);
+         break;
+
+      case PIXEL_FORMAT_YUYV:
+         cv::cvtColor(frame, rgb, cv::COLOR_YUV2RGB_YUYV);
+         break;
+
+      case PIXEL_FORMAT_BGR:
+      default:
+         cv::cvtColor(frame, rgb, cv::COLOR_BGR2RGB);
+         break;
+   }
+}
@@ -0,0 +1,50 @@
+//
+//  FrameFormat.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_FrameFormat_h
+#define UserPerspectiveAR_FrameFormat_h
+
+#include <opencv2/core/core.hpp>
+#include <stdint.h>
+#include <functional>
+
+// Pixel layout of a camera frame handed to ArUco::idle()
+enum PixelFormat {
+   PIXEL_FORMAT_BGR,    // CV_8UC3, what VideoCapture gives by default
+   PIXEL_FORMAT_GREY,   // CV_8UC1, e.g. the luma of a decoded MJPEG frame
+   PIXEL_FORMAT_YUYV,   // CV_8UC2, packed 4:2:2 (Y0 U Y1 V)
+   PIXEL_FORMAT_NV12    // CV_8UC1 of height*3/2 rows: Y plane then interleaved UV
+};
+
+// Frame whose pixels belong to the caller (camera SDK, decoder, capture card buffer...),
+// handed over without a copy. Rows may be padded: stride is the distance in bytes between
+// two rows, NV12 frames keep their UV plane right after the Y plane with the same stride.
+struct ExternalFrame {
+   const void*    data;
+   int            width;
+   int            height;
+   size_t         stride;        // 0 for tightly packed rows
+   PixelFormat    format;
+   int64_t        timestampNs;
+   // Called once the pixels are not read anymore, before the call they were given to
+   // returns. May be empty when the caller manages the buffer itself.
+   std::function<void()> release;
+};
+
+// OpenCV header on the pixels of an external frame (no copy, the step is the frame's stride)
+cv::Mat externalFrameView(const ExternalFrame& frame);
+
+// Size of the image carried by a frame (NV12 frames have extra chroma rows)
+cv::Size frameImageSize(const cv::Mat& frame, PixelFormat format);
+
+// Returns the luma plane of a frame. For GREY and NV12 this is a view on the
+// frame's own buffer (no copy), YUYV needs a single channel extraction into lumaBuffer.
+cv::Mat lumaPlane(const cv::Mat& frame, PixelFormat format, cv::Mat& lumaBuffer);
+
+// Converts a frame to RGB for the OpenGL background (glDrawPixels wants RGB)
+void frameToRGB(const cv::Mat& frame, PixelFormat format, cv::Mat& rgb);
+
+#endif
@@ -0,0 +1,84 @@
+//
+//  FrameHash.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "FrameHash.h"
+#include "Simd.h"
+#include <string.h>
+
+#define SAMPLE_ROWS     64
+#define SAMPLE_BLOCKS   8
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+   return (x << r) | (x >> (64 - r));
+}
+
+// splitmix64 finaliser
+static inline uint64_t mix64(uint64_t x) {
+   x ^= x >> 30;
+   x *= 0xbf58476d1ce4e5b9ULL;
+   x ^= x >> 27;
+   x *= 0x94d049bb133111ebULL;
+   x ^= x >> 31;
+   return x;
+}
+
+uint64_t frameFingerprint(const cv::Mat& frame) {
+   uint64_t h = mix64((uint64_t(frame.rows) << 32) ^ (uint64_t(frame.cols) << 8) ^ uint64_t(frame.type()));
+   if (frame.empty())
+      return h;
+
+   const size_t rowBytes = frame.cols * frame.elemSize();
+   const int rows = frame.rows < SAMPLE_ROWS ? frame.rows : SAMPLE_ROWS;
+
+   // Rows too narrow for a block are simply hashed byte per byte
+   if (rowBytes < 16) {
+      for (int r = 0; r < rows; r++) {
+         const uchar* row = frame.ptr(r * frame.rows / rows);
+         for (size_t b = 0; b < rowBytes; b++)
+            h = mix64(h ^ row[b]);
+      }
+      return h;
+   }
+
+   // Offsets of the blocks in a row, the last one ends on the last byte
+   size_t offsets[SAMPLE_BLOCKS];
+   for (int b = 0; b < SAMPLE_BLOCKS; b++)
+      offsets[b] = (rowBytes - 16) * b / (SAMPLE_BLOCKS - 1);
+
+   // Two lanes of 64 bits: a sum (order independent) and a rotate/xor chain (order dependent)
+#ifdef ARUCO_SSE2
+   __m128i sum = _mm_setzero_si128();
+   __m128i chain = _mm_setzero_si128();
+   for (int r = 0; r < rows; r++) {
+      const uchar* row = frame.ptr(r * frame.rows / rows);
+      for (int b = 0; b < SAMPLE_BLOCKS; b++) {
+         __m128i block = _mm_loadu_si128((const __m128i*)(row + offsets[b]));
+         sum = _mm_add_epi64(sum, block);
+         chain = _mm_xor_si128(_mm_or_si128(_mm_slli_epi64(chain, 5), _mm_srli_epi64(chain, 59)), block);
+      }
+   }
+   uint64_t lanes[4];
+   _mm_storeu_si128((__m128i*)lanes, sum);
+   _mm_storeu_si128((__m128i*)(lanes + 2), chain);
+#else
+   uint64_t lanes[4] = { 0, 0, 0, 0 };
+   for (int r = 0; r < rows; r++) {
+      const uchar* row = frame.ptr(r * frame.rows / rows);
+      for (int b = 0; b < SAMPLE_BLOCKS; b++) {
+         uint64_t block[2];
+         memcpy(block, row + offsets[b], 16);
+         lanes[0] += block[0];
+         lanes[1] += block[1];
+         lanes[2] = rotl64(lanes[2], 5) ^ block[0];
+         lanes[3] = rotl64(lanes[3], 5) ^ block[1];
+      }
+   }
+#endif
+
+   for (int l = 0; l < 4; l++)
+      h = mix64(h ^ rotl64(lanes[l], 17 * l + 1));
+   return h;
+}
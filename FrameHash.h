@@ -0,0 +1,40 @@
+//
+//  FrameHash.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_FrameHash_h
+#define UserPerspectiveAR_FrameHash_h
+
+#include <stdint.h>
+#include <opencv2/core/core.hpp>
+
+// Cheap fingerprint of a frame: a few thousand bytes sampled over a regular grid
+// (64 rows x 8 blocks of 16 bytes), mixed with SSE2 when available.
+// Meant to spot a camera handing back the same buffer twice, not to compare images:
+// two live frames always differ by sensor noise on most samples.
+uint64_t frameFingerprint(const cv::Mat& frame);
+
+// What the duplicate frame check saved
+struct FrameDedupStats {
+   // Frames given to the detection engine
+   uint64_t frames;
+   // Frames skipped because identical to the previous one
+   uint64_t duplicates;
+   // Seconds spent computing fingerprints
+   double   hashTime;
+   // Seconds spent detecting in the frames that were not skipped
+   double   processTime;
+
+   FrameDedupStats() : frames(0), duplicates(0), hashTime(0), processTime(0) {}
+
+   // Processing time the duplicates would have cost
+   double   savedTime() const {
+      if (frames <= duplicates)
+         return 0;
+      return processTime / double(frames - duplicates) * double(duplicates);
+   }
+};
+
+#endif
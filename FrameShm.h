@@ -0,0 +1,178 @@
+//
+//  FrameShm.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+// Shared memory ring through which another process (e.g. the acquisition process that
+// owns the camera) hands frames to the application (--shm-input), read by ShmFrameSource.
+// Plain C so that it can be included by the producer.
+//
+// The region starts with a FrameShmHeader followed by the pixels of each slot. A slot
+// belongs to whoever moved its state with a compare-and-swap:
+//
+//    producer:  FREE -> WRITING, fills pixels and fields, WRITING -> READY
+//    consumer:  READY -> READING on the newest frame (older READY frames go back to
+//               FREE), reads the pixels in place, READING -> FREE
+//
+// Nobody waits on anybody: a producer without a FREE slot drops its frame.
+
+#ifndef UserPerspectiveAR_FrameShm_h
+#define UserPerspectiveAR_FrameShm_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define FRAME_SHM_MAGIC        0x4D524646u   /* "FFRM" */
+#define FRAME_SHM_VERSION      1
+#define FRAME_SHM_MAX_SLOTS    16
+#define FRAME_SHM_ALIGNMENT    64
+
+/* Slot states */
+#define FRAME_SLOT_FREE        0
+#define FRAME_SLOT_WRITING     1
+#define FRAME_SLOT_READY       2
+#define FRAME_SLOT_READING     3
+
+/* Pixel formats, same values as PixelFormat (FrameFormat.h) */
+#define FRAME_SHM_BGR          0   /* 3 bytes per pixel */
+#define FRAME_SHM_GREY         1   /* 1 byte per pixel */
+#define FRAME_SHM_YUYV         2   /* packed 4:2:2, 2 bytes per pixel */
+#define FRAME_SHM_NV12         3   /* Y plane then interleaved UV, height * 3 / 2 rows */
+
+typedef struct FrameShmSlot {
+   uint32_t    state;
+   uint32_t    format;
+   int32_t     width;
+   int32_t     height;
+   int32_t     stride;        /* bytes per row */
+   uint32_t    reserved;
+   uint64_t    frameIndex;
+   int64_t     timestampNs;   /* capture time, monotonic clock of the machine */
+   uint64_t    offset;        /* of the pixels from the start of the region */
+} FrameShmSlot;
+
+typedef struct FrameShmHeader {
+   uint32_t    magic;
+   uint32_t    version;
+   uint32_t    slotCount;
+   uint32_t    format;        /* nominal format and size, frames may differ */
+   int32_t     width;
+   int32_t     height;
+   uint64_t    slotBytes;     /* room for the pixels of each slot */
+   uint64_t    totalBytes;    /* size of the region */
+   uint64_t    produced;      /* frames published so far */
+   FrameShmSlot slots[FRAME_SHM_MAX_SLOTS];
+} FrameShmHeader;
+
+/* Atomic accesses to the fields shared between processes */
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define frame_shm_load32(p)     ((uint32_t)_InterlockedOr((volatile long*)(p), 0))
+#define frame_shm_store32(p, v) _InterlockedExchange((volatile long*)(p), (long)(v))
+#define frame_shm_store64(p, v) _InterlockedExchange64((volatile __int64*)(p), (__int64)(v))
+#define frame_shm_cas32(p, expected, desired) \
+   ((uint32_t)_InterlockedCompareExchange((volatile long*)(p), (long)(desired), (long)(expected)) == (uint32_t)(expected))
+#else
+#define frame_shm_load32(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define frame_shm_store32(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define frame_shm_store64(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+static inline int frame_shm_cas32(uint32_t* p, uint32_t expected, uint32_t desired) {
+   return __atomic_compare_exchange_n(p, &expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+#endif
+
+/* Size of a region of 'slotCount' slots of 'slotBytes' bytes */
+static inline uint64_t frame_shm_region_bytes(uint32_t slotCount, uint64_t slotBytes) {
+   uint64_t header = (sizeof(FrameShmHeader) + FRAME_SHM_ALIGNMENT - 1) / FRAME_SHM_ALIGNMENT * FRAME_SHM_ALIGNMENT;
+   slotBytes = (slotBytes + FRAME_SHM_ALIGNMENT - 1) / FRAME_SHM_ALIGNMENT * FRAME_SHM_ALIGNMENT;
+   return header + slotCount * slotBytes;
+}
+
+/* Producer: lays out a zeroed region of frame_shm_region_bytes() bytes. The magic is
+   written last, consumers ignore the region until then. */
+static inline void frame_shm_init(FrameShmHeader* header, uint32_t slotCount, uint64_t slotBytes,
+                                  int32_t width, int32_t height, uint32_t format) {
+   uint64_t first = (sizeof(FrameShmHeader) + FRAME_SHM_ALIGNMENT - 1) / FRAME_SHM_ALIGNMENT * FRAME_SHM_ALIGNMENT;
+   uint32_t s;
+   if (slotCount > FRAME_SHM_MAX_SLOTS)
+      slotCount = FRAME_SHM_MAX_SLOTS;
+   header->version = FRAME_SHM_VERSION;
+   header->slotCount = slotCount;
+   header->format = format;
+   header->width = width;
+   header->height = height;
+   header->slotBytes = (slotBytes + FRAME_SHM_ALIGNMENT - 1) / FRAME_SHM_ALIGNMENT * FRAME_SHM_ALIGNMENT;
+   header->totalBytes = frame_shm_region_bytes(slotCount, slotBytes);
+   for (s = 0; s < slotCount; s++) {
+      header->slots[s].state = FRAME_SLOT_FREE;
+      header->slots[s].offset = first + s * header->slotBytes;
+   }
+   frame_shm_store32(&header->magic, FRAME_SHM_MAGIC);
+}
+
+static inline unsigned char* frame_shm_pixels(FrameShmHeader* header, int slot) {
+   return (unsigned char*)header + header->slots[slot].offset;
+}
+
+/* Producer: a slot to write the next frame into, -1 if the consumer holds them all */
+static inline int frame_shm_begin_write(FrameShmHeader* header) {
+   uint32_t s;
+   for (s = 0; s < header->slotCount; s++)
+      if (frame_shm_cas32(&header->slots[s].state, FRAME_SLOT_FREE, FRAME_SLOT_WRITING))
+         return (int)s;
+   return -1;
+}
+
+/* Producer: hands the written slot to the consumer */
+static inline void frame_shm_end_write(FrameShmHeader* header, int slot, int32_t width, int32_t height,
+                                       int32_t stride, uint32_t format, int64_t timestampNs) {
+   FrameShmSlot* s = &header->slots[slot];
+   s->width = width;
+   s->height = height;
+   s->stride = stride;
+   s->format = format;
+   s->timestampNs = timestampNs;
+   s->frameIndex = header->produced;
+   frame_shm_store64(&header->produced, header->produced + 1);
+   frame_shm_store32(&s->state, FRAME_SLOT_READY);
+}
+
+/* Consumer: takes the newest frame and gives the older ones back, -1 if there is none.
+   'dropped' (may be NULL) is increased by the number of frames given back unread. */
+static inline int frame_shm_begin_read(FrameShmHeader* header, uint64_t* dropped) {
+   for (;;) {
+      int newest = -1;
+      uint32_t s;
+      for (s = 0; s < header->slotCount; s++)
+         if (frame_shm_load32(&header->slots[s].state) == FRAME_SLOT_READY &&
+             (newest < 0 || header->slots[s].frameIndex > header->slots[newest].frameIndex))
+            newest = (int)s;
+      if (newest < 0)
+         return -1;
+      if (!frame_shm_cas32(&header->slots[newest].state, FRAME_SLOT_READY, FRAME_SLOT_READING))
+         continue;
+
+      /* the index of a slot is only looked at while holding it */
+      for (s = 0; s < header->slotCount; s++) {
+         if ((int)s == newest || !frame_shm_cas32(&header->slots[s].state, FRAME_SLOT_READY, FRAME_SLOT_READING))
+            continue;
+         if (header->slots[s].frameIndex < header->slots[newest].frameIndex) {
+            frame_shm_store32(&header->slots[s].state, FRAME_SLOT_FREE);
+            if (dropped)
+               (*dropped)++;
+         }
+         else
+            frame_shm_store32(&header->slots[s].state, FRAME_SLOT_READY);
+      }
+      return newest;
+   }
+}
+
+/* Consumer: the pixels of the slot may be overwritten from now on */
+static inline void frame_shm_end_read(FrameShmHeader* header, int slot) {
+   frame_shm_store32(&header->slots[slot].state, FRAME_SLOT_FREE);
+}
+
+#endif
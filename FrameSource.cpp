@@ -0,0 +1,34 @@
+//
+//  FrameSource.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "FrameSource.h"
+#include "SimClock.h"
+
+PixelFormat FrameSource::pixelFormat(const cv::Mat& frame) const {
+   switch (frame.type()) {
+   case CV_8UC1: return PIXEL_FORMAT_GREY;
+   case CV_8UC2: return PIXEL_FORMAT_YUYV;
+   default:      return PIXEL_FORMAT_BGR;
+   }
+}
+
+bool VideoCaptureSource::isOpened() const {
+   return m_Capture.isOpened();
+}
+
+bool VideoCaptureSource::read(cv::Mat& frame, int64_t& timestampNs) {
+   bool ok = m_Capture.read(frame);
+   timestampNs = monotonicNanoseconds();
+   return ok && !frame.empty();
+}
+
+cv::Size VideoCaptureSource::frameSize() const {
+   return cv::Size(int(m_Capture.get(cv::CAP_PROP_FRAME_WIDTH)), int(m_Capture.get(cv::CAP_PROP_FRAME_HEIGHT)));
+}
+
+void VideoCaptureSource::release() {
+   m_Capture.release();
+}
@@ -0,0 +1,49 @@
+//
+//  FrameSource.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_FrameSource_h
+#define UserPerspectiveAR_FrameSource_h
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/videoio.hpp>
+#include <stdint.h>
+
+#include "FrameFormat.h"
+
+// Where the frames of the main loop come from (camera, recorded session...)
+class FrameSource {
+public:
+   virtual ~FrameSource() {}
+
+   virtual bool      isOpened() const = 0;
+   // Next frame and its capture time (monotonic clock, ns), false at the end of the source.
+   // The frame may be a view over the source's memory, valid until the next read.
+   virtual bool      read(cv::Mat& frame, int64_t& timestampNs) = 0;
+   // Size of the frames
+   virtual cv::Size  frameSize() const = 0;
+   // Layout of a frame returned by read(), guessed from its type by default
+   virtual PixelFormat pixelFormat(const cv::Mat& frame) const;
+   // Size the frames are used at. Sources that can produce smaller frames for less work
+   // (reduced JPEG decode) may return frames down to that size.
+   virtual void      setTargetSize(cv::Size /*size*/) {}
+   virtual void      release() {}
+};
+
+// Frames of an OpenCV capture, stamped when they are returned
+class VideoCaptureSource : public FrameSource {
+public:
+   explicit VideoCaptureSource(cv::VideoCapture& capture) : m_Capture(capture) {}
+
+   bool              isOpened() const;
+   bool              read(cv::Mat& frame, int64_t& timestampNs);
+   cv::Size          frameSize() const;
+   void              release();
+
+private:
+   cv::VideoCapture& m_Capture;
+};
+
+#endif
@@ -0,0 +1,92 @@
+//
+//  GLExt.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "GLExt.h"
+#include <glfw3.h>
+
+namespace GLExt {
+   GenBuffersProc               GenBuffers = NULL;
+   DeleteBuffersProc            DeleteBuffers = NULL;
+   BindBufferProc               BindBuffer = NULL;
+   BufferDataProc               BufferData = NULL;
+   BufferSubDataProc            BufferSubData = NULL;
+   CreateShaderProc             CreateShader = NULL;
+   DeleteShaderProc             DeleteShader = NULL;
+   ShaderSourceProc             ShaderSource = NULL;
+   CompileShaderProc            CompileShader = NULL;
+   GetShaderivProc              GetShaderiv = NULL;
+   GetShaderInfoLogProc         GetShaderInfoLog = NULL;
+   CreateProgramProc            CreateProgram = NULL;
+   AttachShaderProc             AttachShader = NULL;
+   LinkProgramProc              LinkProgram = NULL;
+   GetProgramivProc             GetProgramiv = NULL;
+   UseProgramProc               UseProgram = NULL;
+   GetAttribLocationProc        GetAttribLocation = NULL;
+   GetUniformLocationProc       GetUniformLocation = NULL;
+   Uniform1iProc                Uniform1i = NULL;
+   EnableVertexAttribArrayProc  EnableVertexAttribArray = NULL;
+   DisableVertexAttribArrayProc DisableVertexAttribArray = NULL;
+   VertexAttribPointerProc      VertexAttribPointer = NULL;
+   VertexAttribDivisorProc      VertexAttribDivisor = NULL;
+   DrawElementsInstancedProc    DrawElementsInstanced = NULL;
+   GenQueriesProc               GenQueries = NULL;
+   DeleteQueriesProc            DeleteQueries = NULL;
+   BeginQueryProc               BeginQuery = NULL;
+   EndQueryProc                 EndQuery = NULL;
+   GetQueryObjectui64vProc      GetQueryObjectui64v = NULL;
+
+   template<class Proc>
+   static void loadProc(Proc& proc, const char* name) {
+      proc = (Proc)glfwGetProcAddress(name);
+   }
+
+   void load() {
+      loadProc(GenBuffers, "glGenBuffers");
+      loadProc(DeleteBuffers, "glDeleteBuffers");
+      loadProc(BindBuffer, "glBindBuffer");
+      loadProc(BufferData, "glBufferData");
+      loadProc(BufferSubData, "glBufferSubData");
+      loadProc(CreateShader, "glCreateShader");
+      loadProc(DeleteShader, "glDeleteShader");
+      loadProc(ShaderSource, "glShaderSource");
+      loadProc(CompileShader, "glCompileShader");
+      loadProc(GetShaderiv, "glGetShaderiv");
+      loadProc(GetShaderInfoLog, "glGetShaderInfoLog");
+      loadProc(CreateProgram, "glCreateProgram");
+      loadProc(AttachShader, "glAttachShader");
+      loadProc(LinkProgram, "glLinkProgram");
+      loadProc(GetProgramiv, "glGetProgramiv");
+      loadProc(UseProgram, "glUseProgram");
+      loadProc(GetAttribLocation, "glGetAttribLocation");
+      loadProc(GetUniformLocation, "glGetUniformLocation");
+      loadProc(Uniform1i, "glUniform1i");
+      loadProc(EnableVertexAttribArray, "glEnableVertexAttribArray");
+      loadProc(DisableVertexAttribArray, "glDisableVertexAttribArray");
+      loadProc(VertexAttribPointer, "glVertexAttribPointer");
+      loadProc(VertexAttribDivisor, "glVertexAttribDivisor");
+      loadProc(DrawElementsInstanced, "glDrawElementsInstanced");
+      loadProc(GenQueries, "glGenQueries");
+      loadProc(DeleteQueries, "glDeleteQueries");
+      loadProc(BeginQuery, "glBeginQuery");
+      loadProc(EndQuery, "glEndQuery");
+      loadProc(GetQueryObjectui64v, "glGetQueryObjectui64v");
+   }
+
+   bool hasBuffers() {
+      return GenBuffers && DeleteBuffers && BindBuffer && BufferData && BufferSubData;
+   }
+
+   bool hasInstancing() {
+      return hasBuffers() && CreateShader && DeleteShader && ShaderSource && CompileShader && GetShaderiv &&
+             GetShaderInfoLog && CreateProgram && AttachShader && LinkProgram && GetProgramiv && UseProgram &&
+             GetAttribLocation && GetUniformLocation && Uniform1i && EnableVertexAttribArray &&
+             DisableVertexAttribArray && VertexAttribPointer && VertexAttribDivisor && DrawElementsInstanced;
+   }
+
+   bool hasTimerQueries() {
+      return GenQueries && DeleteQueries && BeginQuery && EndQuery && GetQueryObjectui64v;
+   }
+}
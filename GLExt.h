@@ -0,0 +1,143 @@
+//
+//  GLExt.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_GLExt_h
+#define UserPerspectiveAR_GLExt_h
+
+#include <Windows.h>
+
+#ifdef __APPLE__
+#include <OPENGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+#include <stddef.h>
+#include <stdint.h>
+
+// OpenGL entry points above 1.1 (buffers, shaders, instancing, timer queries).
+// The Windows headers stop at OpenGL 1.1, so they are loaded at run time through
+// glfwGetProcAddress once a context is current.
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+#ifndef GL_VERSION_1_5
+typedef ptrdiff_t GLsizeiptr;
+typedef ptrdiff_t GLintptr;
+#endif
+#ifndef GL_VERSION_2_0
+typedef char GLchar;
+#endif
+#ifndef GL_VERSION_3_2
+typedef uint64_t GLuint64;
+#endif
+
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER          0x8892
+#endif
+#ifndef GL_ELEMENT_ARRAY_BUFFER
+#define GL_ELEMENT_ARRAY_BUFFER  0x8893
+#endif
+#ifndef GL_STATIC_DRAW
+#define GL_STATIC_DRAW           0x88E4
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW           0x88E0
+#endif
+#ifndef GL_FRAGMENT_SHADER
+#define GL_FRAGMENT_SHADER       0x8B30
+#endif
+#ifndef GL_VERTEX_SHADER
+#define GL_VERTEX_SHADER         0x8B31
+#endif
+#ifndef GL_COMPILE_STATUS
+#define GL_COMPILE_STATUS        0x8B81
+#endif
+#ifndef GL_LINK_STATUS
+#define GL_LINK_STATUS           0x8B82
+#endif
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT          0x8866
+#endif
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED          0x88BF
+#endif
+
+namespace GLExt {
+   // OpenGL 1.5 buffers
+   typedef void (APIENTRY *GenBuffersProc)(GLsizei n, GLuint* buffers);
+   typedef void (APIENTRY *DeleteBuffersProc)(GLsizei n, const GLuint* buffers);
+   typedef void (APIENTRY *BindBufferProc)(GLenum target, GLuint buffer);
+   typedef void (APIENTRY *BufferDataProc)(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+   typedef void (APIENTRY *BufferSubDataProc)(GLenum target, GLintptr offset, GLsizeiptr size, const void* data);
+   // OpenGL 2.0 shaders
+   typedef GLuint (APIENTRY *CreateShaderProc)(GLenum type);
+   typedef void (APIENTRY *DeleteShaderProc)(GLuint shader);
+   typedef void (APIENTRY *ShaderSourceProc)(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length);
+   typedef void (APIENTRY *CompileShaderProc)(GLuint shader);
+   typedef void (APIENTRY *GetShaderivProc)(GLuint shader, GLenum pname, GLint* params);
+   typedef void (APIENTRY *GetShaderInfoLogProc)(GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog);
+   typedef GLuint (APIENTRY *CreateProgramProc)(void);
+   typedef void (APIENTRY *AttachShaderProc)(GLuint program, GLuint shader);
+   typedef void (APIENTRY *LinkProgramProc)(GLuint program);
+   typedef void (APIENTRY *GetProgramivProc)(GLuint program, GLenum pname, GLint* params);
+   typedef void (APIENTRY *UseProgramProc)(GLuint program);
+   typedef GLint (APIENTRY *GetAttribLocationProc)(GLuint program, const GLchar* name);
+   typedef GLint (APIENTRY *GetUniformLocationProc)(GLuint program, const GLchar* name);
+   typedef void (APIENTRY *Uniform1iProc)(GLint location, GLint v0);
+   typedef void (APIENTRY *EnableVertexAttribArrayProc)(GLuint index);
+   typedef void (APIENTRY *DisableVertexAttribArrayProc)(GLuint index);
+   typedef void (APIENTRY *VertexAttribPointerProc)(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer);
+   // OpenGL 3.3 instancing and timer queries
+   typedef void (APIENTRY *VertexAttribDivisorProc)(GLuint index, GLuint divisor);
+   typedef void (APIENTRY *DrawElementsInstancedProc)(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount);
+   typedef void (APIENTRY *GenQueriesProc)(GLsizei n, GLuint* ids);
+   typedef void (APIENTRY *DeleteQueriesProc)(GLsizei n, const GLuint* ids);
+   typedef void (APIENTRY *BeginQueryProc)(GLenum target, GLuint id);
+   typedef void (APIENTRY *EndQueryProc)(GLenum target);
+   typedef void (APIENTRY *GetQueryObjectui64vProc)(GLuint id, GLenum pname, GLuint64* params);
+
+   extern GenBuffersProc               GenBuffers;
+   extern DeleteBuffersProc            DeleteBuffers;
+   extern BindBufferProc               BindBuffer;
+   extern BufferDataProc               BufferData;
+   extern BufferSubDataProc            BufferSubData;
+   extern CreateShaderProc             CreateShader;
+   extern DeleteShaderProc             DeleteShader;
+   extern ShaderSourceProc             ShaderSource;
+   extern CompileShaderProc            CompileShader;
+   extern GetShaderivProc              GetShaderiv;
+   extern GetShaderInfoLogProc         GetShaderInfoLog;
+   extern CreateProgramProc            CreateProgram;
+   extern AttachShaderProc             AttachShader;
+   extern LinkProgramProc              LinkProgram;
+   extern GetProgramivProc             GetProgramiv;
+   extern UseProgramProc               UseProgram;
+   extern GetAttribLocationProc        GetAttribLocation;
+   extern GetUniformLocationProc       GetUniformLocation;
+   extern Uniform1iProc                Uniform1i;
+   extern EnableVertexAttribArrayProc  EnableVertexAttribArray;
+   extern DisableVertexAttribArrayProc DisableVertexAttribArray;
+   extern VertexAttribPointerProc      VertexAttribPointer;
+   extern VertexAttribDivisorProc      VertexAttribDivisor;
+   extern DrawElementsInstancedProc    DrawElementsInstanced;
+   extern GenQueriesProc               GenQueries;
+   extern DeleteQueriesProc            DeleteQueries;
+   extern BeginQueryProc               BeginQuery;
+   extern EndQueryProc                 EndQuery;
+   extern GetQueryObjectui64vProc      GetQueryObjectui64v;
+
+   // Loads the entry points of the current context (safe to call more than once)
+   void  load();
+
+   // What the context offers once loaded
+   bool  hasBuffers();
+   bool  hasInstancing();
+   bool  hasTimerQueries();
+}
+
+#endif
@@ -0,0 +1,32 @@
+//
+//  JpegDecode.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "JpegDecode.h"
+
+#include <opencv2/imgcodecs.hpp>
+
+int jpegScaleFor(cv::Size imageSize, cv::Size targetSize) {
+   if (targetSize.width <= 0 || targetSize.height <= 0)
+      return 1;
+   int scale = 8;
+   while (scale > 1 && (imageSize.width / scale < targetSize.width || imageSize.height / scale < targetSize.height))
+      scale /= 2;
+   return scale;
+}
+
+bool decodeJpeg(const void* data, size_t bytes, int scale, bool lumaOnly, cv::Mat& image) {
+   // IMREAD_REDUCED_* select libjpeg's scale_denom, the grey modes skip the chroma
+   int flags;
+   switch (scale) {
+   case 2:  flags = lumaOnly ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_REDUCED_COLOR_2; break;
+   case 4:  flags = lumaOnly ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_COLOR_4; break;
+   case 8:  flags = lumaOnly ? cv::IMREAD_REDUCED_GRAYSCALE_8 : cv::IMREAD_REDUCED_COLOR_8; break;
+   default: flags = lumaOnly ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR; break;
+   }
+   // decoded into the same buffer when the size does not change
+   cv::imdecode(cv::Mat(1, int(bytes), CV_8UC1, (void*)data), flags, &image);
+   return !image.empty();
+}
@@ -0,0 +1,22 @@
+//
+//  JpegDecode.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_JpegDecode_h
+#define UserPerspectiveAR_JpegDecode_h
+
+#include <opencv2/core/core.hpp>
+#include <stddef.h>
+
+// Largest JPEG scale (1, 2, 4 or 8) at which an image of imageSize still covers
+// targetSize; 1 when targetSize is empty
+int  jpegScaleFor(cv::Size imageSize, cv::Size targetSize);
+
+// Decodes a JPEG image (an MJPEG frame) at 1/scale of its size. libjpeg scales while
+// taking the inverse DCT, so a reduced decode costs a fraction of a full one.
+// lumaOnly decodes the Y component alone (CV_8UC1), otherwise the image is BGR.
+bool decodeJpeg(const void* data, size_t bytes, int scale, bool lumaOnly, cv::Mat& image);
+
+#endif
@@ -0,0 +1,147 @@
+//
+//  Logger.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "Logger.h"
+#include "SimClock.h"
+
+#include <chrono>
+#include <stdarg.h>
+#include <stdio.h>
+
+static const int64_t startTime = monotonicNanoseconds();
+
+bool LogRateLimiter::allow(double interval, unsigned& count) {
+   int64_t now = monotonicNanoseconds();
+   int64_t next = this->next.load(std::memory_order_relaxed);
+   // only one thread wins a period, the others count as suppressed
+   if (now < next || !this->next.compare_exchange_strong(next, now + int64_t(interval * 1e9))) {
+      suppressed.fetch_add(1, std::memory_order_relaxed);
+      return false;
+   }
+   count = suppressed.exchange(0, std::memory_order_relaxed);
+   return true;
+}
+
+Logger& Logger::instance() {
+   static Logger logger;
+   return logger;
+}
+
+Logger::Logger() {
+   for (size_t i = 0; i < CAPACITY; i++)
+      m_Records[i].sequence.store(i, std::memory_order_relaxed);
+   m_Tail = 0;
+   m_Head = 0;
+   m_Written = 0;
+   m_Dropped = 0;
+   m_Level = LOG_COMPILED_LEVEL;
+   m_Stop = false;
+   m_Thread = std::thread(&Logger::run, this);
+}
+
+Logger::~Logger() {
+   shutdown();
+}
+
+void Logger::setLevel(int level) {
+   m_Level = level;
+}
+
+int Logger::getLevel() const {
+   return m_Level;
+}
+
+void Logger::write(int level, unsigned suppressed, const char* format, ...) {
+   if (level < m_Level.load(std::memory_order_relaxed))
+      return;
+
+   // claims a slot (bounded MPMC queue with per-slot sequence numbers)
+   size_t pos = m_Tail.load(std::memory_order_relaxed);
+   Record* record;
+   for (;;) {
+      record = &m_Records[pos % CAPACITY];
+      size_t sequence = record->sequence.load(std::memory_order_acquire);
+      intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+      if (diff == 0) {
+         if (m_Tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            break;
+      }
+      else if (diff < 0) {
+         // full: the background thread cannot keep up
+         m_Dropped.fetch_add(1, std::memory_order_relaxed);
+         return;
+      }
+      else
+         pos = m_Tail.load(std::memory_order_relaxed);
+   }
+
+   record->level = level;
+   record->suppressed = suppressed;
+   record->time = (monotonicNanoseconds() - startTime) * 1e-9;
+   va_list args;
+   va_start(args, format);
+   vsnprintf(record->text, TEXT_SIZE, format, args);
+   va_end(args);
+
+   // hands the slot to the background thread
+   record->sequence.store(pos + 1, std::memory_order_release);
+}
+
+bool Logger::writeNext() {
+   Record& record = m_Records[m_Head % CAPACITY];
+   if (record.sequence.load(std::memory_order_acquire) != m_Head + 1)
+      return false;
+
+   static const char* names[] = { "DEBUG", "INFO ", "WARN ", "ERROR" };
+   int level = record.level < LOG_LEVEL_DEBUG ? LOG_LEVEL_DEBUG : record.level > LOG_LEVEL_ERROR ? LOG_LEVEL_ERROR : record.level;
+   FILE* out = level >= LOG_LEVEL_WARNING ? stderr : stdout;
+   if (record.suppressed)
+      fprintf(out, "[%9.3f] %s %s (%u similar messages suppressed)\n", record.time, names[level], record.text, record.suppressed);
+   else
+      fprintf(out, "[%9.3f] %s %s\n", record.time, names[level], record.text);
+
+   // gives the slot back to the producers
+   record.sequence.store(m_Head + CAPACITY, std::memory_order_release);
+   m_Head++;
+   m_Written.fetch_add(1, std::memory_order_release);
+   return true;
+}
+
+void Logger::run() {
+   for (;;) {
+      bool stop = m_Stop.load(std::memory_order_acquire);
+      bool wrote = false;
+      while (writeNext())
+         wrote = true;
+
+      unsigned dropped = m_Dropped.exchange(0, std::memory_order_relaxed);
+      if (dropped)
+         fprintf(stderr, "Logger: %u messages dropped, the queue was full\n", dropped);
+      if (wrote || dropped) {
+         fflush(stdout);
+         fflush(stderr);
+      }
+
+      if (stop)
+         return;
+      // producers never signal, the queue is polled
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+   }
+}
+
+void Logger::flush() {
+   // every slot claimed before the call is written once the counters meet
+   size_t target = m_Tail.load(std::memory_order_acquire);
+   while (m_Written.load(std::memory_order_acquire) < target && m_Thread.joinable())
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+void Logger::shutdown() {
+   if (!m_Thread.joinable())
+      return;
+   m_Stop.store(true, std::memory_order_release);
+   m_Thread.join();
+}
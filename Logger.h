@@ -0,0 +1,131 @@
+//
+//  Logger.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_Logger_h
+#define UserPerspectiveAR_Logger_h
+
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+
+// Message levels
+#define LOG_LEVEL_DEBUG    0
+#define LOG_LEVEL_INFO     1
+#define LOG_LEVEL_WARNING  2
+#define LOG_LEVEL_ERROR    3
+
+// Messages below this level are removed by the preprocessor, their arguments are not even evaluated
+#ifndef LOG_COMPILED_LEVEL
+#ifdef _DEBUG
+#define LOG_COMPILED_LEVEL LOG_LEVEL_DEBUG
+#else
+#define LOG_COMPILED_LEVEL LOG_LEVEL_INFO
+#endif
+#endif
+
+// Lets a message through at most once per interval and counts the ones it held back.
+// One limiter per call site, see LOG_EVERY.
+struct LogRateLimiter {
+   std::atomic<int64_t>    next;          // steady clock time of the next message (ns)
+   std::atomic<unsigned>   suppressed;
+
+   LogRateLimiter() : next(0), suppressed(0) {}
+
+   // True when the message can be written, count is then the number of messages suppressed since the last one
+   bool     allow(double interval, unsigned& count);
+};
+
+// Asynchronous logger: the calling thread formats the message into a slot of a bounded
+// lock-free queue, a background thread writes the queue to the console.
+// Writing never blocks nor flushes; when the queue is full the message is dropped and counted.
+class Logger {
+public:
+   static Logger& instance();
+
+   // printf-like message, suppressed is the number of similar messages held back by a rate limiter
+   void     write(int level, unsigned suppressed, const char* format, ...);
+
+   // Messages below this level are ignored at run time
+   void     setLevel(int level);
+   int      getLevel() const;
+
+   // Waits until the queued messages are written
+   void     flush();
+   // Writes the queued messages and stops the background thread
+   void     shutdown();
+
+private:
+   Logger();
+   ~Logger();
+   Logger(const Logger&);
+   Logger& operator=(const Logger&);
+
+   void     run();
+   bool     writeNext();
+
+   enum { CAPACITY = 1024, TEXT_SIZE = 232 };
+
+   struct Record {
+      std::atomic<size_t>  sequence;
+      int                  level;
+      unsigned             suppressed;
+      double               time;
+      char                 text[TEXT_SIZE];
+   };
+
+   Record                  m_Records[CAPACITY];
+   std::atomic<size_t>     m_Tail;        // next slot to fill (producers)
+   size_t                  m_Head;        // next slot to write (background thread)
+   std::atomic<size_t>     m_Written;
+   std::atomic<unsigned>   m_Dropped;
+   std::atomic<int>        m_Level;
+   std::atomic<bool>       m_Stop;
+   std::thread             m_Thread;
+};
+
+#define LOG_EVERY_(level, seconds, ...) \
+   do { \
+      static LogRateLimiter logLimiter_; \
+      unsigned logSuppressed_; \
+      if (logLimiter_.allow(seconds, logSuppressed_)) \
+         Logger::instance().write(level, logSuppressed_, __VA_ARGS__); \
+   } while (0)
+
+// LOG_<LEVEL>(format, ...) writes a message,
+// LOG_<LEVEL>_EVERY(seconds, format, ...) writes it at most once per period (for per-frame messages)
+#if LOG_COMPILED_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...)                 Logger::instance().write(LOG_LEVEL_DEBUG, 0, __VA_ARGS__)
+#define LOG_DEBUG_EVERY(seconds, ...)  LOG_EVERY_(LOG_LEVEL_DEBUG, seconds, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...)                 ((void)0)
+#define LOG_DEBUG_EVERY(seconds, ...)  ((void)0)
+#endif
+
+#if LOG_COMPILED_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...)                  Logger::instance().write(LOG_LEVEL_INFO, 0, __VA_ARGS__)
+#define LOG_INFO_EVERY(seconds, ...)   LOG_EVERY_(LOG_LEVEL_INFO, seconds, __VA_ARGS__)
+#else
+#define LOG_INFO(...)                  ((void)0)
+#define LOG_INFO_EVERY(seconds, ...)   ((void)0)
+#endif
+
+#if LOG_COMPILED_LEVEL <= LOG_LEVEL_WARNING
+#define LOG_WARNING(...)               Logger::instance().write(LOG_LEVEL_WARNING, 0, __VA_ARGS__)
+#define LOG_WARNING_EVERY(seconds, ...) LOG_EVERY_(LOG_LEVEL_WARNING, seconds, __VA_ARGS__)
+#else
+#define LOG_WARNING(...)               ((void)0)
+#define LOG_WARNING_EVERY(seconds, ...) ((void)0)
+#endif
+
+#if LOG_COMPILED_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(...)                 Logger::instance().write(LOG_LEVEL_ERROR, 0, __VA_ARGS__)
+#define LOG_ERROR_EVERY(seconds, ...)  LOG_EVERY_(LOG_LEVEL_ERROR, seconds, __VA_ARGS__)
+#else
+#define LOG_ERROR(...)                 ((void)0)
+#define LOG_ERROR_EVERY(seconds, ...)  ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,99 @@
+//
+//  MappedFile.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() {
+   m_Data = NULL;
+   m_Size = 0;
+#ifdef _WIN32
+   m_File = m_Mapping = NULL;
+#endif
+}
+
+MappedFile::~MappedFile() {
+   close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& file) {
+   close();
+   HANDLE handle = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL, NULL);
+   if (handle == INVALID_HANDLE_VALUE)
+      return false;
+   LARGE_INTEGER size;
+   if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+      CloseHandle(handle);
+      return false;
+   }
+   HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+   void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0) : NULL;
+   if (!data) {
+      if (mapping)
+         CloseHandle(mapping);
+      CloseHandle(handle);
+      return false;
+   }
+   m_File = handle;
+   m_Mapping = mapping;
+   m_Data = (unsigned char*)data;
+   m_Size = size_t(size.QuadPart);
+   return true;
+}
+
+void MappedFile::close() {
+   if (m_Data)
+      UnmapViewOfFile(m_Data);
+   if (m_Mapping)
+      CloseHandle(m_Mapping);
+   if (m_File)
+      CloseHandle(m_File);
+   m_Data = NULL;
+   m_Size = 0;
+   m_File = m_Mapping = NULL;
+}
+
+#else
+
+bool MappedFile::open(const std::string& file) {
+   close();
+   int fd = ::open(file.c_str(), O_RDONLY);
+   if (fd < 0)
+      return false;
+   struct stat st;
+   if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      ::close(fd);
+      return false;
+   }
+   void* data = mmap(NULL, size_t(st.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+   // the mapping keeps its own reference to the file
+   ::close(fd);
+   if (data == MAP_FAILED)
+      return false;
+   m_Data = (unsigned char*)data;
+   m_Size = size_t(st.st_size);
+   return true;
+}
+
+void MappedFile::close() {
+   if (m_Data)
+      munmap(m_Data, m_Size);
+   m_Data = NULL;
+   m_Size = 0;
+}
+
+#endif
@@ -0,0 +1,39 @@
+//
+//  MappedFile.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_MappedFile_h
+#define UserPerspectiveAR_MappedFile_h
+
+#include <stddef.h>
+#include <string>
+
+// A whole file mapped in memory (mmap, or MapViewOfFile on Windows).
+// Pages are copy-on-write: writing through data() never changes the file.
+class MappedFile {
+public:
+   MappedFile();
+   ~MappedFile();
+
+   bool     open(const std::string& file);
+   void     close();
+
+   bool     isOpen() const { return m_Data != NULL; }
+   unsigned char* data() const { return m_Data; }
+   size_t   size() const { return m_Size; }
+
+private:
+   MappedFile(const MappedFile&);
+   MappedFile& operator=(const MappedFile&);
+
+   unsigned char* m_Data;
+   size_t         m_Size;
+#ifdef _WIN32
+   void*          m_File;
+   void*          m_Mapping;
+#endif
+};
+
+#endif
@@ -0,0 +1,204 @@
+//
+//  MarkerSynth.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "MarkerSynth.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2\calib3d.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+#include <float.h>
+#include <fstream>
+#include <math.h>
+
+using namespace std;
+using namespace cv;
+
+MarkerSynthesizer::MarkerSynthesizer(const aruco::CameraParameters& camera, const SynthOptions& options, uint64 seed)
+   : m_Camera(camera), m_Options(options), m_Rng(seed) {
+   m_Dictionary = aruco::Dictionary::loadPredefined(options.dictionary);
+   if (m_Camera.CamSize != options.frameSize)
+      m_Camera.resize(options.frameSize);
+}
+
+const Mat& MarkerSynthesizer::markerImage(int id, int pixels) {
+   // one resolution per marker, sharp enough for the largest markers of the sweep
+   map<int, Mat>::iterator it = m_MarkerImages.find(id);
+   if (it == m_MarkerImages.end()) {
+      int cells = int(sqrt(double(m_Dictionary.nbits()))) + 2;
+      Mat image = m_Dictionary.getMarkerImage_id(id, max(4, pixels / cells), false);
+      if (image.channels() != 1)
+         cvtColor(image, image, COLOR_BGR2GRAY);
+      it = m_MarkerImages.insert(make_pair(id, image)).first;
+   }
+   return it->second;
+}
+
+// Multiplies the frame by a linear falloff in a random direction
+void MarkerSynthesizer::addLighting(Mat& grey) {
+   float angle = m_Rng.uniform(0.f, float(2 * CV_PI));
+   float dx = cos(angle) / grey.cols, dy = sin(angle) / grey.rows;
+   float offset = (dx < 0 ? -dx * grey.cols : 0) + (dy < 0 ? -dy * grey.rows : 0);
+   for (int y = 0; y < grey.rows; y++) {
+      uchar* row = grey.ptr<uchar>(y);
+      for (int x = 0; x < grey.cols; x++) {
+         float light = 1.0f - m_Options.gradient * 0.5f * (x * dx + y * dy + offset);
+         row[x] = saturate_cast<uchar>(row[x] * light);
+      }
+   }
+}
+
+void MarkerSynthesizer::render(Mat& frame, vector<SynthMarker>& truth) {
+   const SynthOptions& o = m_Options;
+   Size size = o.frameSize;
+   Mat grey(size, CV_8UC1, Scalar(190));
+   truth.clear();
+
+   // grid with roughly square cells, at least markerCount of them
+   int cols = max(1, int(ceil(sqrt(double(o.markerCount) * size.width / size.height))));
+   int rows = max(1, int(ceil(double(o.markerCount) / cols)));
+   float cellW = float(size.width) / cols, cellH = float(size.height) / rows;
+   float cell = min(cellW, cellH);
+
+   double fx = m_Camera.CameraMatrix.at<float>(0, 0), fy = m_Camera.CameraMatrix.at<float>(1, 1);
+   double cx = m_Camera.CameraMatrix.at<float>(0, 2), cy = m_Camera.CameraMatrix.at<float>(1, 2);
+   double depth = fx * o.markerSize / (o.fill * cell);
+
+   // random cells and ids (ids repeat when there are more markers than the dictionary holds)
+   vector<int> cells(cols * rows), ids(max<size_t>(1, m_Dictionary.size()));
+   for (size_t i = 0; i < cells.size(); i++)
+      cells[i] = int(i);
+   for (size_t i = 0; i < ids.size(); i++)
+      ids[i] = int(i);
+   for (int i = int(cells.size()) - 1; i > 0; i--)
+      swap(cells[i], cells[m_Rng.uniform(0, i + 1)]);
+   for (int i = int(ids.size()) - 1; i > 0; i--)
+      swap(ids[i], ids[m_Rng.uniform(0, i + 1)]);
+
+   vector<Point3f> object = aruco::Marker::get3DPoints(o.markerSize);
+   vector<Point2f> projected;
+   float tilt = float(o.maxTilt * CV_PI / 180);
+   for (int m = 0; m < o.markerCount; m++) {
+      SynthMarker marker;
+      marker.id = ids[m % ids.size()];
+      marker.occluded = false;
+
+      // the marker faces the camera (rotated by pi around x), then is tilted and turned
+      double a = CV_PI + m_Rng.uniform(-tilt, tilt), b = m_Rng.uniform(-tilt, tilt);
+      double c = m_Rng.uniform(0.0, 2 * CV_PI);
+      Matx33d Rx(1, 0, 0, 0, cos(a), -sin(a), 0, sin(a), cos(a));
+      Matx33d Ry(cos(b), 0, sin(b), 0, 1, 0, -sin(b), 0, cos(b));
+      Matx33d Rz(cos(c), -sin(c), 0, sin(c), cos(c), 0, 0, 0, 1);
+      Matx33d R = Rz * Rx * Ry;
+      Rodrigues(R, marker.rvec);
+
+      // centre of the cell, jittered, pushed along its ray
+      int cellIndex = cells[m];
+      double u = (cellIndex % cols + 0.5 + m_Rng.uniform(-0.1, 0.1)) * cellW;
+      double v = (cellIndex / cols + 0.5 + m_Rng.uniform(-0.1, 0.1)) * cellH;
+      double z = depth * m_Rng.uniform(0.9, 1.1);
+      marker.tvec = Vec3d((u - cx) / fx * z, (v - cy) / fy * z, z);
+
+      projectPoints(object, marker.rvec, marker.tvec, m_Camera.CameraMatrix, m_Camera.Distorsion, projected);
+      marker.corners = projected;
+
+      // warps the marker image into its bounding box only
+      Rect box = boundingRect(projected) & Rect(0, 0, size.width, size.height);
+      if (box.area() == 0)
+         continue;
+      const Mat& image = markerImage(marker.id, int(o.fill * cell * 2));
+      Point2f src[4] = { Point2f(0, 0), Point2f(float(image.cols), 0),
+                         Point2f(float(image.cols), float(image.rows)), Point2f(0, float(image.rows)) };
+      Point2f dst[4];
+      for (int k = 0; k < 4; k++)
+         dst[k] = projected[k] - Point2f(float(box.x), float(box.y));
+      Mat roi = grey(box);
+      warpPerspective(image, roi, getPerspectiveTransform(src, dst), roi.size(), INTER_LINEAR, BORDER_TRANSPARENT);
+
+      truth.push_back(marker);
+   }
+
+   // occluders: grey boxes of up to a cell, markers they touch are flagged
+   for (int k = 0; k < o.occluders; k++) {
+      Rect box(m_Rng.uniform(0, size.width), m_Rng.uniform(0, size.height),
+               m_Rng.uniform(int(cell * 0.1f) + 1, int(cell) + 2), m_Rng.uniform(int(cell * 0.1f) + 1, int(cell) + 2));
+      rectangle(grey, box, Scalar(m_Rng.uniform(0, 256)), FILLED);
+      for (size_t m = 0; m < truth.size(); m++)
+         if ((boundingRect(truth[m].corners) & box).area() > 0)
+            truth[m].occluded = true;
+   }
+
+   if (o.gradient > 0)
+      addLighting(grey);
+   if (o.blurSigma > 0)
+      GaussianBlur(grey, grey, Size(), o.blurSigma);
+   if (o.noiseSigma > 0) {
+      Mat noise(size, CV_16SC1);
+      randn(noise, 0, o.noiseSigma);
+      grey.convertTo(grey, CV_16SC1);
+      grey += noise;
+      grey.convertTo(grey, CV_8UC1);
+   }
+
+   if (o.colour)
+      cvtColor(grey, frame, COLOR_GRAY2BGR);
+   else
+      frame = grey;
+}
+
+// Mean distance between two sets of corners, over the 4 possible starting corners
+static float cornerDistance(const vector<Point2f>& a, const vector<Point2f>& b) {
+   float best = FLT_MAX;
+   for (int r = 0; r < 4 && a.size() == 4 && b.size() == 4; r++) {
+      float d = 0;
+      for (int k = 0; k < 4; k++)
+         d += float(norm(a[k] - b[(k + r) % 4]));
+      best = min(best, d / 4);
+   }
+   return best;
+}
+
+float detectionRecall(const vector<SynthMarker>& truth, const vector<aruco::Marker>& detected,
+                      float tolerance, int* falsePositives) {
+   vector<bool> used(detected.size(), false);
+   int visible = 0, found = 0;
+   for (size_t t = 0; t < truth.size(); t++) {
+      if (!truth[t].occluded)
+         visible++;
+      for (size_t d = 0; d < detected.size(); d++) {
+         if (used[d] || detected[d].id != truth[t].id || cornerDistance(truth[t].corners, detected[d]) > tolerance)
+            continue;
+         used[d] = true;
+         if (!truth[t].occluded)
+            found++;
+         break;
+      }
+   }
+   if (falsePositives)
+      *falsePositives = int(count(used.begin(), used.end(), false));
+   return visible ? float(found) / visible : 1.0f;
+}
+
+bool saveSynthFrame(const string& prefix, const Mat& frame, const vector<SynthMarker>& truth) {
+   if (!imwrite(prefix + ".png", frame))
+      return false;
+   ofstream out((prefix + ".csv").c_str());
+   if (!out)
+      return false;
+   out << "id,occluded,x0,y0,x1,y1,x2,y2,x3,y3,rx,ry,rz,tx,ty,tz\n";
+   for (size_t m = 0; m < truth.size(); m++) {
+      const SynthMarker& marker = truth[m];
+      out << marker.id << ',' << marker.occluded;
+      for (int k = 0; k < 4; k++)
+         out << ',' << marker.corners[k].x << ',' << marker.corners[k].y;
+      for (int k = 0; k < 3; k++)
+         out << ',' << marker.rvec[k];
+      for (int k = 0; k < 3; k++)
+         out << ',' << marker.tvec[k];
+      out << '\n';
+   }
+   return bool(out);
+}
@@ -0,0 +1,78 @@
+//
+//  MarkerSynth.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_MarkerSynth_h
+#define UserPerspectiveAR_MarkerSynth_h
+
+#include <opencv2/core/core.hpp>
+#include "aruco/aruco.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// How synthetic frames are rendered
+struct SynthOptions {
+   cv::Size       frameSize;
+   int            markerCount;
+   float          markerSize;       // meters
+   std::string    dictionary;
+   float          fill;             // marker side over grid cell side
+   float          maxTilt;          // degrees, around the marker's own axes
+   float          blurSigma;        // pixels, 0 for none
+   float          noiseSigma;       // grey levels, 0 for none
+   float          gradient;         // lighting falloff across the frame, 0 (flat) to 1
+   int            occluders;        // random boxes drawn over the frame
+   bool           colour;           // BGR frames instead of grey
+
+   SynthOptions() : frameSize(1280, 720), markerCount(10), markerSize(0.105f), dictionary("ARUCO_MIP_36h12"),
+                    fill(0.6f), maxTilt(40), blurSigma(0), noiseSigma(0), gradient(0), occluders(0), colour(false) {}
+};
+
+// Ground truth of a rendered marker, in the conventions of aruco::Marker
+struct SynthMarker {
+   int                        id;
+   std::vector<cv::Point2f>   corners;
+   cv::Vec3d                  rvec;
+   cv::Vec3d                  tvec;
+   // touched by an occluder, a detector is not expected to find it
+   bool                       occluded;
+};
+
+// Renders dictionary markers at random poses into synthetic frames.
+// Markers are laid out on a grid (one per cell, no overlap) at the depth that gives them
+// the requested share of a cell, then tilted and turned at random.
+class MarkerSynthesizer {
+public:
+   MarkerSynthesizer(const aruco::CameraParameters& camera, const SynthOptions& options, uint64 seed = 1);
+
+   // Renders a new frame and returns the markers it contains
+   void     render(cv::Mat& frame, std::vector<SynthMarker>& truth);
+
+   const SynthOptions& options() const { return m_Options; }
+
+private:
+   const cv::Mat& markerImage(int id, int pixels);
+   void     addLighting(cv::Mat& grey);
+
+   aruco::CameraParameters m_Camera;
+   SynthOptions            m_Options;
+   aruco::Dictionary       m_Dictionary;
+   cv::RNG                 m_Rng;
+   // marker images by id, rendered once
+   std::map<int, cv::Mat>  m_MarkerImages;
+};
+
+// Share of the visible markers of truth that were detected at the right place
+// (same id, corners within tolerance pixels), falsePositives counts the other detections
+float detectionRecall(const std::vector<SynthMarker>& truth, const std::vector<aruco::Marker>& detected,
+                      float tolerance, int* falsePositives = NULL);
+
+// Writes frame as prefix.png and its ground truth as prefix.csv
+// (id, occluded, 4 corners, rvec, tvec per line)
+bool saveSynthFrame(const std::string& prefix, const cv::Mat& frame, const std::vector<SynthMarker>& truth);
+
+#endif
@@ -0,0 +1,180 @@
+//
+//  MarkerWhitelist.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "MarkerWhitelist.h"
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+
+// Codes are read the same way as aruco::DictionaryBased: the bit grid is scanned
+// row by row, the last cell being the least significant bit
+static void codeToBits(uint64_t code, int bits, vector<unsigned char>& grid) {
+   grid.assign(bits * bits, 0);
+   int bit = 0;
+   for (int y = bits - 1; y >= 0; y--)
+      for (int x = bits - 1; x >= 0; x--)
+         grid[y * bits + x] = (code >> bit++) & 1;
+}
+
+static uint64_t bitsToCode(const vector<unsigned char>& grid, int bits) {
+   uint64_t code = 0;
+   int bit = 0;
+   for (int y = bits - 1; y >= 0; y--)
+      for (int x = bits - 1; x >= 0; x--)
+         code |= uint64_t(grid[y * bits + x]) << bit++;
+   return code;
+}
+
+// Same rotation as aruco::DictionaryBased::rotate
+static uint64_t rotateCode(uint64_t code, int bits) {
+   vector<unsigned char> in, out(bits * bits);
+   codeToBits(code, bits, in);
+   for (int i = 0; i < bits; i++)
+      for (int j = 0; j < bits; j++)
+         out[i * bits + j] = in[(bits - j - 1) * bits + i];
+   return bitsToCode(out, bits);
+}
+
+WhitelistLabeler::WhitelistLabeler(const string& dictionary, const vector<int>& allowedIds) {
+   if (dictionary == "ALL_DICTS") {
+      vector<string> names = aruco::Dictionary::getDicTypes();
+      for (size_t i = 0; i < names.size(); i++) {
+         if (names[i] != "ALL_DICTS" && names[i] != "CUSTOM")
+            addDictionary(names[i], allowedIds);
+      }
+   }
+   else {
+      addDictionary(dictionary, allowedIds);
+   }
+}
+
+void WhitelistLabeler::addDictionary(const string& name, const vector<int>& allowedIds) {
+   aruco::Dictionary dict;
+   try {
+      dict = aruco::Dictionary::loadPredefined(name);
+   }
+   catch (std::exception& ex) {
+      cerr << "WhitelistLabeler: cannot load dictionary " << name << " (" << ex.what() << ")" << endl;
+      return;
+   }
+
+   int bits = int(std::sqrt(double(dict.nbits())) + 0.5);
+   if (bits <= 0 || bits > 8)
+      return;
+
+   Grid* grid = NULL;
+   for (size_t i = 0; i < m_Grids.size(); i++) {
+      if (m_Grids[i].bits == bits)
+         grid = &m_Grids[i];
+   }
+   if (!grid) {
+      m_Grids.push_back(Grid());
+      grid = &m_Grids.back();
+      grid->bits = bits;
+   }
+
+   const std::map<uint64_t, uint16_t>& mapCode = dict.getMapCode();
+   for (std::map<uint64_t, uint16_t>::const_iterator it = mapCode.begin(); it != mapCode.end(); ++it) {
+      if (std::find(allowedIds.begin(), allowedIds.end(), int(it->second)) == allowedIds.end())
+         continue;
+
+      // A marker seen with k clockwise rotations reads as the k-th rotation of its code,
+      // aruco reports the number of rotations that bring it back to the dictionary code
+      uint64_t code = it->first;
+      for (int k = 0; k < 4; k++) {
+         Code entry;
+         entry.id = it->second;
+         entry.nRotations = (4 - k) % 4;
+         entry.dictionary = name;
+         grid->codes.insert(make_pair(code, entry));
+         code = rotateCode(code, bits);
+      }
+   }
+}
+
+size_t WhitelistLabeler::size() const {
+   size_t n = 0;
+   for (size_t i = 0; i < m_Grids.size(); i++)
+      n += m_Grids[i].codes.size();
+   return n;
+}
+
+int WhitelistLabeler::getBestInputSize() {
+   // enough pixels per cell for the largest grid
+   int cells = 0;
+   for (size_t i = 0; i < m_Grids.size(); i++)
+      cells = std::max(cells, m_Grids[i].bits + 2);
+   return cells * 8;
+}
+
+int WhitelistLabeler::getNSubdivisions() const {
+   return m_Grids.empty() ? -1 : m_Grids[0].bits + 2;
+}
+
+string WhitelistLabeler::getName() const {
+   return "WHITELIST";
+}
+
+// Majority vote of each cell of the (bits+2)x(bits+2) grid, border must be black
+bool WhitelistLabeler::readInnerCode(const cv::Mat& thresImg, int bits, uint64_t& code) {
+   int cells = bits + 2;
+   m_NonZeros.assign(cells * cells, 0);
+   m_NValues.assign(cells * cells, 0);
+
+   for (int y = 0; y < thresImg.rows; y++) {
+      const uchar* ptr = thresImg.ptr<uchar>(y);
+      int my = cells * y / thresImg.rows;
+      for (int x = 0; x < thresImg.cols; x++) {
+         int c = my * cells + cells * x / thresImg.cols;
+         m_NonZeros[c] += ptr[x] > 125;
+         m_NValues[c]++;
+      }
+   }
+
+   code = 0;
+   int bit = bits * bits;
+   for (int y = 0; y < cells; y++) {
+      for (int x = 0; x < cells; x++) {
+         bool white = m_NonZeros[y * cells + x] > m_NValues[y * cells + x] / 2;
+         bool border = (y == 0 || x == 0 || y == cells - 1 || x == cells - 1);
+         if (border) {
+            if (white)
+               return false;
+         }
+         else {
+            code |= uint64_t(white) << --bit;
+         }
+      }
+   }
+   return true;
+}
+
+bool WhitelistLabeler::detect(const cv::Mat& in, int& marker_id, int& nRotations, string& additionalInfo) {
+   if (in.type() == CV_8UC1)
+      cv::threshold(in, m_Thres, 125, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+   else {
+      cv::cvtColor(in, m_Thres, cv::COLOR_BGR2GRAY);
+      cv::threshold(m_Thres, m_Thres, 125, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+   }
+
+   for (size_t i = 0; i < m_Grids.size(); i++) {
+      uint64_t code;
+      if (!readInnerCode(m_Thres, m_Grids[i].bits, code))
+         continue;
+
+      std::unordered_map<uint64_t, Code>::const_iterator it = m_Grids[i].codes.find(code);
+      if (it != m_Grids[i].codes.end()) {
+         marker_id = it->second.id;
+         nRotations = it->second.nRotations;
+         additionalInfo = it->second.dictionary;
+         return true;
+      }
+   }
+   return false;
+}
@@ -0,0 +1,58 @@
+//
+//  MarkerWhitelist.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_MarkerWhitelist_h
+#define UserPerspectiveAR_MarkerWhitelist_h
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "aruco/aruco.h"
+
+// Marker labeler only accepting a given set of marker IDs.
+// The codes of the allowed markers, in their 4 rotations, are hashed once so that
+// a candidate costs a single lookup and anything else is rejected before the
+// detector estimates its pose.
+class WhitelistLabeler : public aruco::MarkerLabeler {
+public:
+   // dictionary: name of an ArUco dictionary, "ALL_DICTS" takes all predefined ones
+   WhitelistLabeler(const std::string& dictionary, const std::vector<int>& allowedIds);
+
+   bool        detect(const cv::Mat& in, int& marker_id, int& nRotations, std::string& additionalInfo);
+   int         getBestInputSize();
+   int         getNSubdivisions() const;
+   std::string getName() const;
+
+   // Number of codes in the table (allowed markers x rotations)
+   size_t      size() const;
+
+private:
+   struct Code {
+      int         id;
+      int         nRotations;
+      std::string dictionary;
+   };
+
+   // Codes of a given bit grid size (dictionaries do not all use the same)
+   struct Grid {
+      int                                  bits;
+      std::unordered_map<uint64_t, Code>   codes;
+   };
+
+   void  addDictionary(const std::string& name, const std::vector<int>& allowedIds);
+   bool  readInnerCode(const cv::Mat& thresImg, int bits, uint64_t& code);
+
+   std::vector<Grid>    m_Grids;
+
+   // Per candidate scratch buffers
+   cv::Mat              m_Thres;
+   std::vector<int>     m_NonZeros;
+   std::vector<int>     m_NValues;
+};
+
+#endif
@@ -0,0 +1,328 @@
+//
+//  PoseBatch.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "PoseBatch.h"
+#include <opencv2/calib3d.hpp>
+#include <algorithm>
+#include <cmath>
+
+// Corners of the marker in its own frame, in the order given by the detector
+// (in units of half the marker size)
+static const double CORNER_X[4] = { -1.0,  1.0,  1.0, -1.0 };
+static const double CORNER_Y[4] = {  1.0,  1.0, -1.0, -1.0 };
+
+void PoseBuffer::resize(size_t n) {
+   count = n;
+   if (id.size() >= n)
+      return;
+   id.resize(n);
+   rx.resize(n); ry.resize(n); rz.resize(n);
+   tx.resize(n); ty.resize(n); tz.resize(n);
+   error.resize(n);
+}
+
+PoseBatchSolver::PoseBatchSolver() {
+   m_Refine = false;
+}
+
+void PoseBatchSolver::setRefinement(bool refine) {
+   m_Refine = refine;
+}
+
+void PoseBatchSolver::reserve(size_t n) {
+   m_Corners.resize(4 * n);
+   if (m_Err1.size() >= n)
+      return;
+   for (int k = 0; k < 4; k++) {
+      m_U[k].resize(n);
+      m_V[k].resize(n);
+   }
+   for (int k = 0; k < 9; k++) {
+      m_H[k].resize(n);
+      m_R1[k].resize(n);
+      m_R2[k].resize(n);
+   }
+   for (int k = 0; k < 3; k++) {
+      m_T1[k].resize(n);
+      m_T2[k].resize(n);
+   }
+   m_Err1.resize(n);
+   m_Err2.resize(n);
+}
+
+// Least squares translation of each marker given its rotation (closed form of the
+// 3x3 normal equations, the model is planar and centred)
+static void planarTranslations(size_t n, double hs, std::vector<double>* U, std::vector<double>* V,
+                               std::vector<double>* R, std::vector<double>* T) {
+   for (size_t i = 0; i < n; i++) {
+      double su = 0, sv = 0, suv2 = 0, b0 = 0, b1 = 0, b2 = 0;
+      for (int j = 0; j < 4; j++) {
+         double X = hs * CORNER_X[j], Y = hs * CORNER_Y[j];
+         double u = U[j][i], v = V[j][i];
+         double a = R[0][i] * X + R[1][i] * Y;
+         double b = R[3][i] * X + R[4][i] * Y;
+         double c = R[6][i] * X + R[7][i] * Y;
+         double eu = u * c - a;
+         double ev = v * c - b;
+         su += u;
+         sv += v;
+         suv2 += u * u + v * v;
+         b0 += eu;
+         b1 += ev;
+         b2 -= u * eu + v * ev;
+      }
+      double tz = (b2 + (su * b0 + sv * b1) * 0.25) / (suv2 - (su * su + sv * sv) * 0.25);
+      T[2][i] = tz;
+      T[0][i] = (b0 + su * tz) * 0.25;
+      T[1][i] = (b1 + sv * tz) * 0.25;
+   }
+}
+
+// Sum of squared reprojection errors of the 4 corners of marker i for a pose (R row major)
+static double reprojectionError(size_t i, double hs, std::vector<double>* U, std::vector<double>* V,
+                                const double R[9], const double T[3]) {
+   double e = 0;
+   for (int j = 0; j < 4; j++) {
+      double X = hs * CORNER_X[j], Y = hs * CORNER_Y[j];
+      double x = R[0] * X + R[1] * Y + T[0];
+      double y = R[3] * X + R[4] * Y + T[1];
+      double z = R[6] * X + R[7] * Y + T[2];
+      double du = x / z - U[j][i];
+      double dv = y / z - V[j][i];
+      e += du * du + dv * dv;
+   }
+   return e;
+}
+
+// Same for the poses of all the markers
+static void reprojectionErrors(size_t n, double hs, std::vector<double>* U, std::vector<double>* V,
+                               std::vector<double>* R, std::vector<double>* T, std::vector<double>& err) {
+   for (size_t i = 0; i < n; i++) {
+      double rot[9], t[3];
+      for (int k = 0; k < 9; k++)
+         rot[k] = R[k][i];
+      for (int k = 0; k < 3; k++)
+         t[k] = T[k][i];
+      err[i] = reprojectionError(i, hs, U, V, rot, t);
+   }
+}
+
+void PoseBatchSolver::solve(std::vector<aruco::Marker>& markers, const aruco::CameraParameters& camParams,
+                            float markerSize, PoseBuffer& poses) {
+   const size_t n = markers.size();
+   poses.resize(n);
+   if (n == 0)
+      return;
+   reserve(n);
+
+   // All the corners of the frame are undistorted at once
+   for (size_t i = 0; i < n; i++)
+      for (int j = 0; j < 4; j++)
+         m_Corners[4 * i + j] = markers[i][j];
+   cv::undistortPoints(m_Corners, m_Normalized, camParams.CameraMatrix, camParams.Distorsion);
+   for (size_t i = 0; i < n; i++) {
+      for (int j = 0; j < 4; j++) {
+         m_U[j][i] = m_Normalized[4 * i + j].x;
+         m_V[j][i] = m_Normalized[4 * i + j].y;
+      }
+   }
+
+   const double hs = markerSize / 2.0;
+   const double s = 1.0 / markerSize;
+
+   // Homography from the marker plane to the normalised image:
+   // square to quad mapping (Heckbert) composed with model -> unit square
+   for (size_t i = 0; i < n; i++) {
+      double x0 = m_U[0][i], x1 = m_U[1][i], x2 = m_U[2][i], x3 = m_U[3][i];
+      double y0 = m_V[0][i], y1 = m_V[1][i], y2 = m_V[2][i], y3 = m_V[3][i];
+      double sx = x0 - x1 + x2 - x3;
+      double sy = y0 - y1 + y2 - y3;
+      double dx1 = x1 - x2, dx2 = x3 - x2;
+      double dy1 = y1 - y2, dy2 = y3 - y2;
+      double den = dx1 * dy2 - dx2 * dy1;
+      double g = (sx * dy2 - dx2 * sy) / den;
+      double h = (dx1 * sy - sx * dy1) / den;
+      double a = x1 - x0 + g * x1, b = x3 - x0 + h * x3;
+      double d = y1 - y0 + g * y1, e = y3 - y0 + h * y3;
+      double inv = 1.0 / (0.5 * (g + h) + 1.0);
+      m_H[0][i] = a * s * inv;
+      m_H[1][i] = -b * s * inv;
+      m_H[2][i] = (0.5 * (a + b) + x0) * inv;
+      m_H[3][i] = d * s * inv;
+      m_H[4][i] = -e * s * inv;
+      m_H[5][i] = (0.5 * (d + e) + y0) * inv;
+      m_H[6][i] = g * s * inv;
+      m_H[7][i] = -h * s * inv;
+      m_H[8][i] = 1.0;
+   }
+
+   // IPPE: the two rotations compatible with the homography's jacobian at the marker centre
+   for (size_t i = 0; i < n; i++) {
+      double p = m_H[2][i], q = m_H[5][i];
+      double j00 = m_H[0][i] - m_H[6][i] * p, j01 = m_H[1][i] - m_H[7][i] * p;
+      double j10 = m_H[3][i] - m_H[6][i] * q, j11 = m_H[4][i] - m_H[7][i] * q;
+
+      // Rv brings the z axis on the ray going through the marker centre
+      double nrm = 1.0 / std::sqrt(p * p + q * q + 1.0);
+      double ax = p * nrm, ay = q * nrm, az = nrm;
+      double d = 1.0 / (1.0 + az);
+      double rv00 = 1.0 - ax * ax * d, rv01 = -ax * ay * d, rv02 = ax;
+      double rv10 = -ax * ay * d, rv11 = 1.0 - ay * ay * d, rv12 = ay;
+      double rv20 = -ax, rv21 = -ay, rv22 = az;
+
+      double b00 = rv00 - p * rv20, b01 = rv01 - p * rv21;
+      double b10 = rv10 - q * rv20, b11 = rv11 - q * rv21;
+      double dtinv = 1.0 / (b00 * b11 - b01 * b10);
+      double binv00 = dtinv * b11, binv01 = -dtinv * b01;
+      double binv10 = -dtinv * b10, binv11 = dtinv * b00;
+
+      double a00 = binv00 * j00 + binv01 * j10, a01 = binv00 * j01 + binv01 * j11;
+      double a10 = binv10 * j00 + binv11 * j10, a11 = binv10 * j01 + binv11 * j11;
+
+      // largest singular value of A
+      double ata00 = a00 * a00 + a01 * a01;
+      double ata01 = a00 * a10 + a01 * a11;
+      double ata11 = a10 * a10 + a11 * a11;
+      double gamma = std::sqrt(0.5 * (ata00 + ata11 + std::sqrt((ata00 - ata11) * (ata00 - ata11) + 4.0 * ata01 * ata01)));
+
+      double r00 = a00 / gamma, r01 = a01 / gamma;
+      double r10 = a10 / gamma, r11 = a11 / gamma;
+      double c0 = std::sqrt(std::max(0.0, 1.0 - r00 * r00 - r10 * r10));
+      double c1 = std::sqrt(std::max(0.0, 1.0 - r01 * r01 - r11 * r11));
+      c1 = (-r00 * r01 - r10 * r11) < 0 ? -c1 : c1;
+
+      // third column of the local rotation (cross product of the first two)
+      double x2 = r10 * c1 - c0 * r11;
+      double y2 = c0 * r01 - r00 * c1;
+      double z2 = r00 * r11 - r01 * r10;
+
+      m_R1[0][i] = r00 * rv00 + r10 * rv01 + c0 * rv02;
+      m_R1[1][i] = r01 * rv00 + r11 * rv01 + c1 * rv02;
+      m_R1[2][i] = x2 * rv00 + y2 * rv01 + z2 * rv02;
+      m_R1[3][i] = r00 * rv10 + r10 * rv11 + c0 * rv12;
+      m_R1[4][i] = r01 * rv10 + r11 * rv11 + c1 * rv12;
+      m_R1[5][i] = x2 * rv10 + y2 * rv11 + z2 * rv12;
+      m_R1[6][i] = r00 * rv20 + r10 * rv21 + c0 * rv22;
+      m_R1[7][i] = r01 * rv20 + r11 * rv21 + c1 * rv22;
+      m_R1[8][i] = x2 * rv20 + y2 * rv21 + z2 * rv22;
+
+      // second solution: the plane flipped around the line of sight
+      m_R2[0][i] = r00 * rv00 + r10 * rv01 - c0 * rv02;
+      m_R2[1][i] = r01 * rv00 + r11 * rv01 - c1 * rv02;
+      m_R2[2][i] = -x2 * rv00 - y2 * rv01 + z2 * rv02;
+      m_R2[3][i] = r00 * rv10 + r10 * rv11 - c0 * rv12;
+      m_R2[4][i] = r01 * rv10 + r11 * rv11 - c1 * rv12;
+      m_R2[5][i] = -x2 * rv10 - y2 * rv11 + z2 * rv12;
+      m_R2[6][i] = r00 * rv20 + r10 * rv21 - c0 * rv22;
+      m_R2[7][i] = r01 * rv20 + r11 * rv21 - c1 * rv22;
+      m_R2[8][i] = -x2 * rv20 - y2 * rv21 + z2 * rv22;
+   }
+
+   planarTranslations(n, hs, m_U, m_V, m_R1, m_T1);
+   planarTranslations(n, hs, m_U, m_V, m_R2, m_T2);
+   reprojectionErrors(n, hs, m_U, m_V, m_R1, m_T1, m_Err1);
+   reprojectionErrors(n, hs, m_U, m_V, m_R2, m_T2, m_Err2);
+
+   if (m_Refine && m_ObjectPoints.rows != 4) {
+      m_ObjectPoints.create(4, 1, CV_32FC3);
+      m_RefineR.create(3, 1, CV_64FC1);
+      m_RefineT.create(3, 1, CV_64FC1);
+   }
+   if (m_Refine) {
+      for (int j = 0; j < 4; j++)
+         m_ObjectPoints.at<cv::Point3f>(j) = cv::Point3f(float(hs * CORNER_X[j]), float(hs * CORNER_Y[j]), 0.f);
+   }
+
+   // Keeping the solution that reprojects best and writing it back
+   for (size_t i = 0; i < n; i++) {
+      bool first = m_Err1[i] <= m_Err2[i];
+      std::vector<double>* R = first ? m_R1 : m_R2;
+      std::vector<double>* T = first ? m_T1 : m_T2;
+
+      double rot[9], rvec[3];
+      for (int k = 0; k < 9; k++)
+         rot[k] = R[k][i];
+      rotationToRodrigues(rot, rvec);
+      double tvec[3] = { T[0][i], T[1][i], T[2][i] };
+      double err = first ? m_Err1[i] : m_Err2[i];
+
+      if (m_Refine) {
+         cv::Mat imagePoints(4, 1, CV_32FC2, &m_Corners[4 * i]);
+         for (int k = 0; k < 3; k++) {
+            m_RefineR.at<double>(k) = rvec[k];
+            m_RefineT.at<double>(k) = tvec[k];
+         }
+         cv::solvePnPRefineLM(m_ObjectPoints, imagePoints, camParams.CameraMatrix, camParams.Distorsion, m_RefineR, m_RefineT);
+         for (int k = 0; k < 3; k++) {
+            rvec[k] = m_RefineR.at<double>(k);
+            tvec[k] = m_RefineT.at<double>(k);
+         }
+         // the error is the one of the pose given back
+         cv::Matx33d refined;
+         cv::Rodrigues(m_RefineR, refined);
+         err = reprojectionError(i, hs, m_U, m_V, refined.val, tvec);
+      }
+
+      poses.id[i] = markers[i].id;
+      poses.rx[i] = rvec[0]; poses.ry[i] = rvec[1]; poses.rz[i] = rvec[2];
+      poses.tx[i] = tvec[0]; poses.ty[i] = tvec[1]; poses.tz[i] = tvec[2];
+      poses.error[i] = std::sqrt(err / 4.0);
+
+      // the marker keeps its pose so that glGetModelViewMatrix() can be used as before
+      aruco::Marker& marker = markers[i];
+      marker.Rvec.create(3, 1, CV_32FC1);
+      marker.Tvec.create(3, 1, CV_32FC1);
+      for (int k = 0; k < 3; k++) {
+         marker.Rvec.at<float>(k, 0) = float(rvec[k]);
+         marker.Tvec.at<float>(k, 0) = float(tvec[k]);
+      }
+      marker.ssize = markerSize;
+   }
+}
+
+// Through the unit quaternion (Shepperd's method) to stay stable for angles close to 180 degrees,
+// which is the usual case for a marker facing the camera
+void rotationToRodrigues(const double R[9], double r[3]) {
+   double w, x, y, z;
+   double trace = R[0] + R[4] + R[8];
+   if (trace > 0) {
+      double s = 2.0 * std::sqrt(trace + 1.0);
+      w = 0.25 * s;
+      x = (R[7] - R[5]) / s;
+      y = (R[2] - R[6]) / s;
+      z = (R[3] - R[1]) / s;
+   }
+   else if (R[0] > R[4] && R[0] > R[8]) {
+      double s = 2.0 * std::sqrt(1.0 + R[0] - R[4] - R[8]);
+      w = (R[7] - R[5]) / s;
+      x = 0.25 * s;
+      y = (R[1] + R[3]) / s;
+      z = (R[2] + R[6]) / s;
+   }
+   else if (R[4] > R[8]) {
+      double s = 2.0 * std::sqrt(1.0 + R[4] - R[0] - R[8]);
+      w = (R[2] - R[6]) / s;
+      x = (R[1] + R[3]) / s;
+      y = 0.25 * s;
+      z = (R[5] + R[7]) / s;
+   }
+   else {
+      double s = 2.0 * std::sqrt(1.0 + R[8] - R[0] - R[4]);
+      w = (R[3] - R[1]) / s;
+      x = (R[2] + R[6]) / s;
+      y = (R[5] + R[7]) / s;
+      z = 0.25 * s;
+   }
+   if (w < 0) {
+      w = -w; x = -x; y = -y; z = -z;
+   }
+
+   double norm = std::sqrt(x * x + y * y + z * z);
+   double scale = norm < 1e-12 ? 2.0 : 2.0 * std::atan2(norm, w) / norm;
+   r[0] = x * scale;
+   r[1] = y * scale;
+   r[2] = z * scale;
+}
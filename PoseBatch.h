@@ -0,0 +1,68 @@
+//
+//  PoseBatch.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_PoseBatch_h
+#define UserPerspectiveAR_PoseBatch_h
+
+#include <vector>
+
+#include "aruco/aruco.h"
+
+// Poses of all the markers of a frame, stored as structure of arrays
+struct PoseBuffer {
+   size_t               count;
+   std::vector<int>     id;
+   // Rodrigues rotation vector
+   std::vector<double>  rx, ry, rz;
+   // Translation (in meters)
+   std::vector<double>  tx, ty, tz;
+   // RMS reprojection error of the pose above, refined or not (normalised image coordinates)
+   std::vector<double>  error;
+
+   PoseBuffer() : count(0) {}
+
+   // Grows the buffer, never shrinks it so that steady state frames do not allocate
+   void  resize(size_t n);
+};
+
+// Pose estimation for all the square markers of a frame at once.
+// Corners are undistorted in a single call, then the closed form planar pose
+// (IPPE, Collins & Bartoli 2014) is computed with flat loops over the markers so
+// that the compiler can vectorise them. An optional Levenberg-Marquardt refinement
+// can be run on top with the same settings for every marker.
+class PoseBatchSolver {
+public:
+   PoseBatchSolver();
+
+   // Enables the iterative refinement after the closed form solution
+   void  setRefinement(bool refine);
+
+   // Computes the poses of the markers (corners must be expressed in the image the camera
+   // parameters correspond to), writes them in poses and in the Rvec/Tvec of each marker
+   void  solve(std::vector<aruco::Marker>& markers, const aruco::CameraParameters& camParams,
+               float markerSize, PoseBuffer& poses);
+
+private:
+   void  reserve(size_t n);
+
+   bool                       m_Refine;
+
+   // Scratch buffers, reused from one frame to the next
+   std::vector<cv::Point2f>   m_Corners;
+   std::vector<cv::Point2f>   m_Normalized;
+   std::vector<double>        m_U[4], m_V[4];
+   std::vector<double>        m_H[9];
+   std::vector<double>        m_R1[9], m_R2[9];
+   std::vector<double>        m_T1[3], m_T2[3];
+   std::vector<double>        m_Err1, m_Err2;
+   cv::Mat                    m_ObjectPoints;
+   cv::Mat                    m_RefineR, m_RefineT;
+};
+
+// Rodrigues vector of a rotation matrix (row major), valid around 180 degrees as well
+void rotationToRodrigues(const double R[9], double r[3]);
+
+#endif
@@ -0,0 +1,199 @@
+//
+//  PosePublisher.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifdef _WIN32
+// before PoseShm.h, which includes Windows.h
+#include <winsock2.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "PosePublisher.h"
+#include "PoseShm.h"
+#include "Logger.h"
+
+using namespace std;
+
+#ifdef _WIN32
+static const uintptr_t NO_SOCKET = INVALID_SOCKET;
+#else
+static const int NO_SOCKET = -1;
+#endif
+
+PosePublisher::PosePublisher() {
+   m_Region = NULL;
+#ifdef _WIN32
+   m_Mapping = NULL;
+#endif
+   m_Socket = NO_SOCKET;
+   m_Datagram = NULL;
+   m_Port = 0;
+   m_Published = 0;
+}
+
+PosePublisher::~PosePublisher() {
+   close();
+}
+
+bool PosePublisher::openSharedMemory(const string& name) {
+   if (m_Region)
+      return false;
+
+#ifdef _WIN32
+   // Windows names cannot start with a slash
+   string mappingName = name[0] == '/' ? name.substr(1) : name;
+   HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(PoseShmRegion),
+                                       mappingName.c_str());
+   void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(PoseShmRegion)) : NULL;
+   if (!data) {
+      if (mapping)
+         CloseHandle(mapping);
+      LOG_ERROR("Cannot create the shared memory %s", name.c_str());
+      return false;
+   }
+   m_Mapping = mapping;
+#else
+   int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+   if (fd < 0 || ftruncate(fd, sizeof(PoseShmRegion)) != 0) {
+      if (fd >= 0)
+         ::close(fd);
+      LOG_ERROR("Cannot create the shared memory %s", name.c_str());
+      return false;
+   }
+   void* data = mmap(NULL, sizeof(PoseShmRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   ::close(fd);
+   if (data == MAP_FAILED) {
+      LOG_ERROR("Cannot map the shared memory %s", name.c_str());
+      return false;
+   }
+#endif
+
+   // Readers only trust the region once the magic is set
+   m_Region = (PoseShmRegion*)data;
+   memset(m_Region, 0, sizeof(PoseShmRegion));
+   m_Region->version = POSE_SHM_VERSION;
+   m_Region->slotCount = POSE_SHM_SLOTS;
+   m_Region->maxMarkers = POSE_SHM_MAX_MARKERS;
+   pose_shm_store32(&m_Region->magic, POSE_SHM_MAGIC);
+   m_ShmName = name;
+   return true;
+}
+
+bool PosePublisher::openUdp(int port) {
+   if (m_Socket != NO_SOCKET)
+      return false;
+
+#ifdef _WIN32
+   WSADATA wsa;
+   if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+      return false;
+#endif
+   m_Socket = socket(AF_INET, SOCK_DGRAM, 0);
+   if (m_Socket == NO_SOCKET) {
+      LOG_ERROR("Cannot create the pose socket");
+      return false;
+   }
+
+   // Sending must never wait for the readers
+#ifdef _WIN32
+   u_long nonBlocking = 1;
+   ioctlsocket(m_Socket, FIONBIO, &nonBlocking);
+   sockaddr_in address = {};
+   address.sin_family = AF_INET;
+   address.sin_port = htons(u_short(port));
+   address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   connect(m_Socket, (sockaddr*)&address, sizeof(address));
+#else
+   fcntl(m_Socket, F_SETFL, fcntl(m_Socket, F_GETFL) | O_NONBLOCK);
+   sockaddr_in address = {};
+   address.sin_family = AF_INET;
+   address.sin_port = htons(uint16_t(port));
+   address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   connect(m_Socket, (sockaddr*)&address, sizeof(address));
+#endif
+
+   m_Datagram = new PoseShmSlot();
+   m_Port = port;
+   return true;
+}
+
+void PosePublisher::close() {
+   if (m_Region) {
+#ifdef _WIN32
+      UnmapViewOfFile(m_Region);
+      CloseHandle(m_Mapping);
+      m_Mapping = NULL;
+#else
+      munmap(m_Region, sizeof(PoseShmRegion));
+      shm_unlink(m_ShmName.c_str());
+#endif
+      m_Region = NULL;
+   }
+   if (m_Socket != NO_SOCKET) {
+#ifdef _WIN32
+      closesocket(m_Socket);
+      WSACleanup();
+#else
+      ::close(m_Socket);
+#endif
+      m_Socket = NO_SOCKET;
+   }
+   delete m_Datagram;
+   m_Datagram = NULL;
+}
+
+bool PosePublisher::isOpen() const {
+   return m_Region != NULL || m_Socket != NO_SOCKET;
+}
+
+void toPoseShmMarker(const aruco::Marker& marker, PoseShmMarker& out) {
+   out.id = marker.id;
+   for (int k = 0; k < 4; k++) {
+      out.corners[2 * k] = marker[k].x;
+      out.corners[2 * k + 1] = marker[k].y;
+   }
+   bool hasPose = marker.Rvec.total() == 3 && marker.Tvec.total() == 3 && marker.Rvec.type() == CV_32F;
+   for (int k = 0; k < 3; k++) {
+      out.rvec[k] = hasPose ? marker.Rvec.ptr<float>(0)[k] : 0;
+      out.tvec[k] = hasPose ? marker.Tvec.ptr<float>(0)[k] : 0;
+   }
+}
+
+void PosePublisher::fillSlot(PoseShmSlot* slot, const vector<aruco::Marker>& markers, int64_t captureNs) {
+   uint32_t count = uint32_t(min(markers.size(), size_t(POSE_SHM_MAX_MARKERS)));
+   for (uint32_t m = 0; m < count; m++)
+      toPoseShmMarker(markers[m], slot->markers[m]);
+   slot->markerCount = count;
+   slot->frameIndex = m_Published;
+   slot->captureNs = captureNs;
+   slot->publishNs = pose_shm_now_ns();
+}
+
+void PosePublisher::publish(const vector<aruco::Marker>& markers, int64_t captureNs) {
+   if (m_Region) {
+      // seqlock: odd while writing, readers retry if it changed during their copy
+      PoseShmSlot* slot = &m_Region->slots[m_Published % POSE_SHM_SLOTS];
+      uint32_t sequence = slot->sequence;
+      pose_shm_store32(&slot->sequence, sequence + 1);
+      pose_shm_fence();
+      fillSlot(slot, markers, captureNs);
+      pose_shm_store32(&slot->sequence, sequence + 2);
+      pose_shm_store64(&m_Region->latest, m_Published + 1);
+   }
+
+   if (m_Datagram) {
+      fillSlot(m_Datagram, markers, captureNs);
+      // nobody listening or socket buffer full: the frame is lost for UDP readers
+      send(m_Socket, (const char*)m_Datagram, int(POSE_SLOT_BYTES(m_Datagram->markerCount)), 0);
+   }
+   m_Published++;
+}
@@ -0,0 +1,62 @@
+//
+//  PosePublisher.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_PosePublisher_h
+#define UserPerspectiveAR_PosePublisher_h
+
+#include "aruco/aruco.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct PoseShmRegion;
+struct PoseShmSlot;
+struct PoseShmMarker;
+
+// Publishes the markers of each frame to other processes of the machine, through a
+// shared memory ring (layout and reader in PoseShm.h) and/or UDP datagrams on localhost.
+// Everything is allocated when opening: publish() only copies and never blocks.
+class PosePublisher {
+public:
+   PosePublisher();
+   ~PosePublisher();
+
+   // Shared memory region (POSIX name such as "/aruco_poses", a mapping name on Windows)
+   bool     openSharedMemory(const std::string& name);
+   // Datagrams sent to 127.0.0.1:port
+   bool     openUdp(int port);
+   void     close();
+   bool     isOpen() const;
+
+   // Markers beyond POSE_SHM_MAX_MARKERS are dropped
+   void     publish(const std::vector<aruco::Marker>& markers, int64_t captureNs);
+
+   uint64_t publishedFrames() const { return m_Published; }
+
+private:
+   PosePublisher(const PosePublisher&);
+   PosePublisher& operator=(const PosePublisher&);
+
+   void     fillSlot(PoseShmSlot* slot, const std::vector<aruco::Marker>& markers, int64_t captureNs);
+
+   std::string    m_ShmName;
+   PoseShmRegion* m_Region;
+#ifdef _WIN32
+   void*          m_Mapping;
+   uintptr_t      m_Socket;
+#else
+   int            m_Socket;
+#endif
+   PoseShmSlot*   m_Datagram;
+   int            m_Port;
+   uint64_t       m_Published;
+};
+
+// Corners and pose of a marker in the published layout (zero pose when it has none)
+void toPoseShmMarker(const aruco::Marker& marker, PoseShmMarker& out);
+
+#endif
@@ -0,0 +1,125 @@
+//
+//  PoseShm.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+// Layout of the marker poses published by PosePublisher, for readers in other processes.
+// Plain C so that it can be included by any client.
+//
+// Shared memory: the region is a ring of slots, each protected by a sequence counter
+// (seqlock). The writer makes the counter odd, fills the slot, makes it even again and
+// then advances 'latest'. A reader copies a slot and keeps the copy only if the counter
+// was even and unchanged around the copy (see pose_shm_read_latest()).
+//
+// UDP: each datagram is a PoseShmSlot truncated after its markerCount markers.
+//
+// Timestamps are in nanoseconds of the monotonic clock (CLOCK_MONOTONIC, or
+// QueryPerformanceCounter on Windows), see pose_shm_now_ns().
+
+#ifndef UserPerspectiveAR_PoseShm_h
+#define UserPerspectiveAR_PoseShm_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define POSE_SHM_MAGIC        0x45534F50u   /* "POSE" */
+#define POSE_SHM_VERSION      1
+#define POSE_SHM_SLOTS        8
+#define POSE_SHM_MAX_MARKERS  64
+#define POSE_SHM_DEFAULT_NAME "/aruco_poses"
+#define POSE_UDP_DEFAULT_PORT 47800
+
+typedef struct PoseShmMarker {
+   int32_t     id;
+   float       corners[8];    /* image coordinates, x y for the 4 corners */
+   float       rvec[3];       /* rotation (Rodrigues) and translation of the marker in the */
+   float       tvec[3];       /* camera frame, zero when the pose is unknown */
+} PoseShmMarker;
+
+typedef struct PoseShmSlot {
+   uint32_t    sequence;      /* odd while the slot is being written */
+   uint32_t    markerCount;
+   uint64_t    frameIndex;
+   int64_t     captureNs;     /* when the frame was captured */
+   int64_t     publishNs;     /* when the poses were written */
+   PoseShmMarker markers[POSE_SHM_MAX_MARKERS];
+} PoseShmSlot;
+
+typedef struct PoseShmRegion {
+   uint32_t    magic;
+   uint32_t    version;
+   uint32_t    slotCount;
+   uint32_t    maxMarkers;
+   uint64_t    latest;        /* number of frames published, the last one is in slot (latest - 1) % slotCount */
+   uint64_t    reserved;
+   PoseShmSlot slots[POSE_SHM_SLOTS];
+} PoseShmRegion;
+
+/* Bytes of a slot holding 'count' markers (size of a UDP datagram) */
+#define POSE_SLOT_BYTES(count) (offsetof(PoseShmSlot, markers) + (count) * sizeof(PoseShmMarker))
+
+/* Ordered accesses to the counters shared between processes */
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define pose_shm_load32(p)     ((uint32_t)_InterlockedOr((volatile long*)(p), 0))
+#define pose_shm_load64(p)     ((uint64_t)_InterlockedOr64((volatile __int64*)(p), 0))
+#define pose_shm_store32(p, v) _InterlockedExchange((volatile long*)(p), (long)(v))
+#define pose_shm_store64(p, v) _InterlockedExchange64((volatile __int64*)(p), (__int64)(v))
+#define pose_shm_fence()       MemoryBarrier()
+#else
+#define pose_shm_load32(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define pose_shm_load64(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define pose_shm_store32(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define pose_shm_store64(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define pose_shm_fence()       __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+/* Monotonic clock of the publisher */
+static inline int64_t pose_shm_now_ns(void) {
+#ifdef _WIN32
+   LARGE_INTEGER counter, frequency;
+   QueryPerformanceCounter(&counter);
+   QueryPerformanceFrequency(&frequency);
+   return (int64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+/* Copies the last published frame into 'out'.
+   Returns its number (1 for the first frame), 0 if nothing was published yet. */
+static inline uint64_t pose_shm_read_latest(const PoseShmRegion* region, PoseShmSlot* out) {
+   for (;;) {
+      uint64_t latest = pose_shm_load64(&region->latest);
+      if (latest == 0)
+         return 0;
+
+      const PoseShmSlot* slot = &region->slots[(latest - 1) % POSE_SHM_SLOTS];
+      uint32_t before = pose_shm_load32(&slot->sequence);
+      if (before & 1)
+         continue;   /* being written: the writer lapped us, try the new latest */
+
+      uint32_t count = slot->markerCount;
+      if (count > POSE_SHM_MAX_MARKERS)
+         count = POSE_SHM_MAX_MARKERS;
+      memcpy(out, slot, POSE_SLOT_BYTES(count));
+
+      pose_shm_fence();
+      if (pose_shm_load32(&slot->sequence) == before) {
+         out->markerCount = count;
+         return latest;
+      }
+   }
+}
+
+#endif
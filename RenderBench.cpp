@@ -0,0 +1,166 @@
+//
+//  RenderBench.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "RenderBench.h"
+#include "ArUco-OpenGL.h"
+#include "GLExt.h"
+
+#include <glfw3.h>
+#include <opencv2\calib3d.hpp>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+// Markers of the scene on a grid in front of the camera, facing it with a small random tilt
+static vector<Marker> stressMarkers(int count, const SceneConfig& scene, const CameraParameters& camera, RNG& rng) {
+   const vector<int>& ids = scene.bodies.ids();
+   Size size = camera.CamSize;
+   int cols = max(1, int(ceil(sqrt(double(count) * size.width / size.height))));
+   int rows = max(1, (count + cols - 1) / cols);
+   float cellW = float(size.width) / cols, cellH = float(size.height) / rows;
+
+   double fx = camera.CameraMatrix.at<float>(0, 0), fy = camera.CameraMatrix.at<float>(1, 1);
+   double cx = camera.CameraMatrix.at<float>(0, 2), cy = camera.CameraMatrix.at<float>(1, 2);
+   double depth = fx * scene.markerSize / (0.6 * min(cellW, cellH));
+
+   vector<Point3f> object = Marker::get3DPoints(scene.markerSize);
+   vector<Point2f> corners;
+   vector<Marker> markers;
+   for (int m = 0; m < count; m++) {
+      Mat rvec(3, 1, CV_32F), tvec(3, 1, CV_32F);
+      rvec.at<float>(0) = float(CV_PI) + rng.uniform(-0.3f, 0.3f);
+      rvec.at<float>(1) = rng.uniform(-0.3f, 0.3f);
+      rvec.at<float>(2) = 0;
+      double u = (m % cols + 0.5) * cellW, v = (m / cols + 0.5) * cellH;
+      tvec.at<float>(0) = float((u - cx) / fx * depth);
+      tvec.at<float>(1) = float((v - cy) / fy * depth);
+      tvec.at<float>(2) = float(depth);
+      projectPoints(object, rvec, tvec, camera.CameraMatrix, camera.Distorsion, corners);
+
+      Marker marker(corners, ids.empty() ? 0 : ids[m % ids.size()]);
+      marker.Rvec = rvec;
+      marker.Tvec = tvec;
+      marker.ssize = scene.markerSize;
+      markers.push_back(marker);
+   }
+   return markers;
+}
+
+int runRenderBenchmark() {
+   const int counts[] = { 1, 10, 100, 1000, 5000 };
+   const RenderPath paths[] = { RENDER_LEGACY, RENDER_VBO, RENDER_INSTANCED };
+   const int warmupFrames = 20, frames = 200;
+   const int width = 1280, height = 720;
+
+   SceneConfig scene = defaultSceneConfig();
+   loadScene("scene.yml", scene);
+   CameraParameters camera;
+   camera.readFromXMLFile(scene.cameraFile);
+   if (!camera.isValid()) {
+      fprintf(stderr, "No camera parameters in %s\n", scene.cameraFile.c_str());
+      return 1;
+   }
+
+   // Hidden window, no vsync: frames are only bounded by the renderer
+   if (!glfwInit())
+      return 1;
+   glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+   GLFWwindow* window = glfwCreateWindow(width, height, "ArUco render benchmark", NULL, NULL);
+   if (!window) {
+      glfwTerminate();
+      return 1;
+   }
+   glfwMakeContextCurrent(window);
+   glfwSwapInterval(0);
+
+   // same states as the application
+   glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+   glClearDepth(1.0);
+   glShadeModel(GL_SMOOTH);
+   glEnable(GL_NORMALIZE);
+   glEnable(GL_CULL_FACE);
+   glCullFace(GL_BACK);
+
+   ArUco* aruco = new ArUco(scene.cameraFile, scene.markerSize);
+   aruco->setScene(scene);
+   aruco->resize(width, height);
+
+   GLExt::load();
+   bool gpuTiming = GLExt::hasTimerQueries();
+   vector<GLuint> queries(frames);
+   if (gpuTiming)
+      GLExt::GenQueries(frames, &queries[0]);
+
+   // gives the loader thread time to decode the textures, they are uploaded one per frame
+   RNG rng(42);
+   aruco->setMarkers(stressMarkers(1, scene, camera, rng), camera.CamSize);
+   for (int f = 0; f < 50; f++) {
+      aruco->drawScene();
+      glfwSwapBuffers(window);
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+   }
+
+   printf("CPU: time spent in drawScene, GPU: timer query around it (ms per frame, %d frames)\n", frames);
+   printf("%8s", "markers");
+   for (size_t p = 0; p < sizeof(paths) / sizeof(paths[0]); p++)
+      printf(" %10s cpu %10s gpu", renderPathName(paths[p]), renderPathName(paths[p]));
+   printf("\n");
+
+   for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+      aruco->setMarkers(stressMarkers(counts[c], scene, camera, rng), camera.CamSize);
+      printf("%8d", counts[c]);
+      for (size_t p = 0; p < sizeof(paths) / sizeof(paths[0]); p++) {
+         if (aruco->setRenderPath(paths[p]) != paths[p]) {
+            printf(" %14s %14s", "n/a", "n/a");
+            continue;
+         }
+
+         for (int f = 0; f < warmupFrames; f++) {
+            glClear(GL_DEPTH_BUFFER_BIT);
+            aruco->drawScene();
+            glfwSwapBuffers(window);
+         }
+         glFinish();
+
+         double cpu = 0;
+         for (int f = 0; f < frames; f++) {
+            glClear(GL_DEPTH_BUFFER_BIT);
+            int64 start = getTickCount();
+            if (gpuTiming)
+               GLExt::BeginQuery(GL_TIME_ELAPSED, queries[f]);
+            aruco->drawScene();
+            if (gpuTiming)
+               GLExt::EndQuery(GL_TIME_ELAPSED);
+            cpu += double(getTickCount() - start) / getTickFrequency();
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+         }
+         glFinish();
+
+         double gpu = 0;
+         for (int f = 0; f < frames && gpuTiming; f++) {
+            GLuint64 ns = 0;
+            GLExt::GetQueryObjectui64v(queries[f], GL_QUERY_RESULT, &ns);
+            gpu += ns * 1e-9;
+         }
+         printf(" %14.3f", cpu / frames * 1e3);
+         if (gpuTiming)
+            printf(" %14.3f", gpu / frames * 1e3);
+         else
+            printf(" %14s", "n/a");
+      }
+      printf("\n");
+   }
+
+   if (gpuTiming)
+      GLExt::DeleteQueries(frames, &queries[0]);
+   delete aruco;
+   glfwDestroyWindow(window);
+   glfwTerminate();
+   return 0;
+}
@@ -0,0 +1,15 @@
+//
+//  RenderBench.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_RenderBench_h
+#define UserPerspectiveAR_RenderBench_h
+
+// Render-only stress test: drawScene() in a hidden window with 1 to 5000 synthetic
+// markers, for each sphere path (legacy, VBO, instanced). Prints the CPU time spent
+// submitting a frame and the GPU time (timer queries) per frame. Returns the exit code.
+int runRenderBenchmark();
+
+#endif
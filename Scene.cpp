@@ -0,0 +1,56 @@
+//
+//  Scene.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "Scene.h"
+#include <algorithm>
+#include <cmath>
+
+void SceneTable::add(int id, const SceneBody& body) {
+   if (id < 0)
+      return;
+   if (unsigned(id) >= m_Bodies.size())
+      m_Bodies.resize(id + 1);
+   if (m_Bodies[id].role == BODY_NONE)
+      m_Ids.push_back(id);
+   m_Bodies[id] = body;
+}
+
+const std::vector<int>& SceneTable::ids() const {
+   return m_Ids;
+}
+
+void SceneTable::updateOrbits(double time) {
+   for (size_t i = 0; i < m_Ids.size(); i++) {
+      SceneBody& body = m_Bodies[m_Ids[i]];
+      body.orbitAngle = float(std::fmod(body.phase + body.speed * time, 360.0));
+   }
+}
+
+static bool byRadiusThenDistance(const OrbitSample& a, const OrbitSample& b) {
+   if (a.radius != b.radius)
+      return a.radius < b.radius;
+   return a.distance < b.distance;
+}
+
+bool checkOrbitOrdering(std::vector<OrbitSample>& samples) {
+   std::sort(samples.begin(), samples.end(), byRadiusThenDistance);
+
+   // Bodies sharing an orbit radius may come in any order, each group must only
+   // lie beyond every body of a smaller orbit
+   float maxInnerDistance = -1.0f;
+   size_t i = 0;
+   while (i < samples.size()) {
+      size_t end = i;
+      while (end < samples.size() && samples[end].radius == samples[i].radius)
+         end++;
+      // group sorted by distance: its first element is the closest to the sun
+      if (samples[i].distance < maxInnerDistance)
+         return false;
+      maxInnerDistance = std::max(maxInnerDistance, samples[end - 1].distance);
+      i = end;
+   }
+   return true;
+}
@@ -0,0 +1,82 @@
+//
+//  Scene.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_Scene_h
+#define UserPerspectiveAR_Scene_h
+
+#include <string>
+#include <vector>
+
+// What a marker stands for in the scene
+enum BodyRole {
+   BODY_NONE,     // marker not part of the scene
+   BODY_SUN,      // centre of the orbits
+   BODY_PLANET
+};
+
+// A celestial body attached to a marker
+struct SceneBody {
+   BodyRole       role;
+   // Orbit speed (degrees per second) and radius (used when the body is drawn around the sun)
+   float          speed;
+   float          radius;
+   // Orbit angle at time 0 and at the current simulation time (degrees)
+   float          phase;
+   float          orbitAngle;
+   std::string    name;
+   std::string    textureFile;
+   // OpenGL texture, 0 until the image has been decoded and uploaded
+   unsigned int   textureID;
+
+   SceneBody() : role(BODY_NONE), speed(0), radius(0), phase(0), orbitAngle(0), textureID(0) {}
+   SceneBody(BodyRole r, float s, float rad, const std::string& n, const std::string& tex, float ph = 0)
+      : role(r), speed(s), radius(rad), phase(ph), orbitAngle(ph), name(n), textureFile(tex), textureID(0) {}
+};
+
+// A planet marker seen in the image, for the orbit layout check
+struct OrbitSample {
+   // Orbit radius of the body
+   float          radius;
+   // Distance of the marker to the sun marker in the image
+   float          distance;
+};
+
+// True when the planet markers are laid out like their orbits: a body on a larger orbit
+// is never closer to the sun than a body on a smaller one. Sorts the samples, O(n log n).
+bool checkOrbitOrdering(std::vector<OrbitSample>& samples);
+
+// Bodies of the scene, stored in a flat table indexed by marker ID
+// (dictionary IDs are small, so the table stays a few KB)
+class SceneTable {
+public:
+   // Adds or replaces the body attached to a marker ID
+   void              add(int id, const SceneBody& body);
+
+   // Body attached to a marker ID, NULL when the ID is not part of the scene
+   const SceneBody*  find(int id) const {
+      if (unsigned(id) >= m_Bodies.size() || m_Bodies[id].role == BODY_NONE)
+         return NULL;
+      return &m_Bodies[id];
+   }
+   SceneBody*        find(int id) {
+      if (unsigned(id) >= m_Bodies.size() || m_Bodies[id].role == BODY_NONE)
+         return NULL;
+      return &m_Bodies[id];
+   }
+
+   // Marker IDs used by the scene
+   const std::vector<int>& ids() const;
+
+   // Sets the orbit angle of every body for a simulation time (seconds).
+   // Angles only depend on the time, not on how many frames were drawn before.
+   void              updateOrbits(double time);
+
+private:
+   std::vector<SceneBody>  m_Bodies;
+   std::vector<int>        m_Ids;
+};
+
+#endif
@@ -0,0 +1,221 @@
+//
+//  SceneFile.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "SceneFile.h"
+#include "Logger.h"
+
+#include <opencv2/core.hpp>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+// "SCNB" followed by the format version
+static const uint32_t SCENE_CACHE_MAGIC = 0x424E4353;
+static const uint32_t SCENE_CACHE_VERSION = 2;   // 2: modification time in nanoseconds
+
+SceneConfig defaultSceneConfig() {
+   SceneConfig config;
+   config.cameraFile = "camera.yml";
+   config.markerSize = 0.105f;
+   // orbit speeds in degrees per second
+   config.bodies.add(141, SceneBody(BODY_PLANET, 60.0f, 0.2f, "Earth", "textures/earth.jpg"));
+   config.bodies.add(217, SceneBody(BODY_SUN, 0.0f, 0.0f, "Sun", "textures/sun.jpg"));
+   config.bodies.add(144, SceneBody(BODY_PLANET, 30.0f, 0.4f, "Jupiter", "textures/jupiter.jpg"));
+   return config;
+}
+
+bool readSceneFile(const string& file, SceneConfig& config) {
+   cv::FileStorage fs(file, cv::FileStorage::READ);
+   if (!fs.isOpened())
+      return false;
+
+   SceneConfig scene;
+   scene.cameraFile = (string)fs["camera"];
+   scene.markerSize = (float)fs["marker_size"];
+   cv::FileNode bodies = fs["bodies"];
+   if (scene.cameraFile.empty() || scene.markerSize <= 0 || !bodies.isSeq()) {
+      cerr << "Invalid scene file " << file << endl;
+      return false;
+   }
+
+   for (int i = 0; i < (int)bodies.size(); i++) {
+      cv::FileNode node = bodies[i];
+      string role = (string)node["role"];
+      int id = (int)node["id"];
+      if (id < 0 || (role != "sun" && role != "planet")) {
+         cerr << "Skipping body " << i << " of " << file << ": bad id or role" << endl;
+         continue;
+      }
+      scene.bodies.add(id, SceneBody(role == "sun" ? BODY_SUN : BODY_PLANET,
+                                     (float)node["speed"], (float)node["radius"],
+                                     (string)node["name"], (string)node["texture"],
+                                     (float)node["phase"]));
+   }
+
+   config = scene;
+   return true;
+}
+
+// Cache serialization
+static void writeValue(ofstream& out, const void* value, size_t size) {
+   out.write((const char*)value, size);
+}
+
+static void writeString(ofstream& out, const string& s) {
+   uint32_t len = uint32_t(s.size());
+   writeValue(out, &len, sizeof(len));
+   out.write(s.data(), len);
+}
+
+static bool readValue(ifstream& in, void* value, size_t size) {
+   return bool(in.read((char*)value, size));
+}
+
+static bool readString(ifstream& in, string& s) {
+   uint32_t len;
+   if (!readValue(in, &len, sizeof(len)) || len > 4096)
+      return false;
+   s.resize(len);
+   return len == 0 || bool(in.read(&s[0], len));
+}
+
+bool readSceneCache(const string& file, SceneConfig& config) {
+   int64_t mtime, size;
+   if (!fileStamp(file, mtime, size))
+      return false;
+   ifstream in((file + ".bin").c_str(), ios::binary);
+   if (!in)
+      return false;
+
+   uint32_t magic, version;
+   int64_t cachedTime, cachedSize;
+   if (!readValue(in, &magic, sizeof(magic)) || magic != SCENE_CACHE_MAGIC ||
+       !readValue(in, &version, sizeof(version)) || version != SCENE_CACHE_VERSION ||
+       !readValue(in, &cachedTime, sizeof(cachedTime)) || !readValue(in, &cachedSize, sizeof(cachedSize)) ||
+       cachedTime != mtime || cachedSize != size)
+      return false;
+
+   SceneConfig scene;
+   uint32_t count;
+   if (!readString(in, scene.cameraFile) || !readValue(in, &scene.markerSize, sizeof(float)) ||
+       !readValue(in, &count, sizeof(count)))
+      return false;
+   for (uint32_t i = 0; i < count; i++) {
+      int32_t id, role;
+      SceneBody body;
+      if (!readValue(in, &id, sizeof(id)) || !readValue(in, &role, sizeof(role)) ||
+          !readValue(in, &body.speed, sizeof(float)) || !readValue(in, &body.radius, sizeof(float)) ||
+          !readValue(in, &body.phase, sizeof(float)) ||
+          !readString(in, body.name) || !readString(in, body.textureFile))
+         return false;
+      if (role != BODY_SUN && role != BODY_PLANET)
+         return false;
+      body.role = BodyRole(role);
+      body.orbitAngle = body.phase;
+      scene.bodies.add(id, body);
+   }
+
+   config = scene;
+   return true;
+}
+
+bool writeSceneCache(const string& file, const SceneConfig& config) {
+   int64_t mtime, size;
+   if (!fileStamp(file, mtime, size))
+      return false;
+   ofstream out((file + ".bin").c_str(), ios::binary | ios::trunc);
+   if (!out)
+      return false;
+
+   writeValue(out, &SCENE_CACHE_MAGIC, sizeof(uint32_t));
+   writeValue(out, &SCENE_CACHE_VERSION, sizeof(uint32_t));
+   writeValue(out, &mtime, sizeof(mtime));
+   writeValue(out, &size, sizeof(size));
+   writeString(out, config.cameraFile);
+   writeValue(out, &config.markerSize, sizeof(float));
+
+   const vector<int>& ids = config.bodies.ids();
+   uint32_t count = uint32_t(ids.size());
+   writeValue(out, &count, sizeof(count));
+   for (size_t i = 0; i < ids.size(); i++) {
+      const SceneBody& body = *config.bodies.find(ids[i]);
+      int32_t id = ids[i], role = body.role;
+      writeValue(out, &id, sizeof(id));
+      writeValue(out, &role, sizeof(role));
+      writeValue(out, &body.speed, sizeof(float));
+      writeValue(out, &body.radius, sizeof(float));
+      writeValue(out, &body.phase, sizeof(float));
+      writeString(out, body.name);
+      writeString(out, body.textureFile);
+   }
+   return bool(out);
+}
+
+bool loadScene(const string& file, SceneConfig& config, bool useCache) {
+   if (useCache && readSceneCache(file, config))
+      return true;
+   if (!readSceneFile(file, config))
+      return false;
+   if (!writeSceneCache(file, config))
+      cerr << "Could not write the scene cache " << file << ".bin" << endl;
+   return true;
+}
+
+// Reloading
+
+SceneReloader::SceneReloader() {
+   m_Stop = false;
+   m_Ready = false;
+}
+
+SceneReloader::~SceneReloader() {
+   stop();
+}
+
+void SceneReloader::start(const string& file) {
+   stop();
+   m_File = file;
+   m_Stop = false;
+   m_Thread = thread(&SceneReloader::run, this);
+}
+
+void SceneReloader::stop() {
+   m_Stop = true;
+   if (m_Thread.joinable())
+      m_Thread.join();
+}
+
+bool SceneReloader::poll(SceneConfig& config) {
+   lock_guard<mutex> lock(m_Mutex);
+   if (!m_Ready)
+      return false;
+   config = m_Config;
+   m_Ready = false;
+   return true;
+}
+
+void SceneReloader::run() {
+   FileWatcher watcher;
+   watcher.open(m_File);
+   while (!m_Stop) {
+      // short waits so that stop() does not hang
+      if (!watcher.wait(200))
+         continue;
+
+      // the file was just written: parsed again whatever the cache says
+      SceneConfig config;
+      if (!loadScene(m_File, config, false)) {
+         LOG_WARNING("Scene %s not reloaded", m_File.c_str());
+         continue;
+      }
+      LOG_INFO("Scene %s reloaded", m_File.c_str());
+
+      lock_guard<mutex> lock(m_Mutex);
+      m_Config = config;
+      m_Ready = true;
+   }
+}
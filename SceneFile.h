@@ -0,0 +1,70 @@
+//
+//  SceneFile.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_SceneFile_h
+#define UserPerspectiveAR_SceneFile_h
+
+#include "Scene.h"
+#include "FileWatcher.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Everything the application needs to know about the scene
+struct SceneConfig {
+   // Camera intrinsics file and marker side (meters)
+   std::string    cameraFile;
+   float          markerSize;
+   SceneTable     bodies;
+
+   SceneConfig() : markerSize(0) {}
+};
+
+// The solar system used when there is no scene file
+SceneConfig defaultSceneConfig();
+
+// Parses a YAML scene file:
+//    camera: "camera.yml"
+//    marker_size: 0.105
+//    bodies:
+//       - { id: 141, role: "planet", name: "Earth", speed: 60., radius: 0.2, texture: "textures/earth.jpg" }
+bool readSceneFile(const std::string& file, SceneConfig& config);
+
+// Binary cache next to the scene file (file + ".bin"), only valid while the
+// modification time (nanoseconds) and the size of the scene file are the ones it was built from
+bool readSceneCache(const std::string& file, SceneConfig& config);
+bool writeSceneCache(const std::string& file, const SceneConfig& config);
+
+// Loads a scene from its cache, or parses it and rebuilds the cache
+// (always parsed without useCache, the cache is rebuilt all the same)
+bool loadScene(const std::string& file, SceneConfig& config, bool useCache = true);
+
+// Reloads a scene file in a background thread each time it is written
+class SceneReloader {
+public:
+   SceneReloader();
+   ~SceneReloader();
+
+   void     start(const std::string& file);
+   void     stop();
+
+   // Takes the last scene loaded, false when the file did not change (never blocks)
+   bool     poll(SceneConfig& config);
+
+private:
+   void     run();
+
+   std::string       m_File;
+   std::thread       m_Thread;
+   std::atomic<bool> m_Stop;
+   std::mutex        m_Mutex;
+   SceneConfig       m_Config;
+   bool              m_Ready;
+};
+
+#endif
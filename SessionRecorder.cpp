@@ -0,0 +1,205 @@
+//
+//  SessionRecorder.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "SessionRecorder.h"
+#include "SimClock.h"
+#include "Logger.h"
+
+#include <opencv2/imgcodecs.hpp>
+#include <string.h>
+
+using namespace std;
+
+static_assert(sizeof(SessionFileHeader) == 32, "session header layout");
+static_assert(sizeof(SessionRecordHeader) % SESSION_ALIGNMENT == 0, "session record header layout");
+static_assert(sizeof(SessionMarker) == 60, "session marker layout");
+
+static size_t alignSession(size_t size) {
+   return (size + SESSION_ALIGNMENT - 1) / SESSION_ALIGNMENT * SESSION_ALIGNMENT;
+}
+
+SessionRecorder::SessionRecorder() {
+   m_File = NULL;
+   m_Encoding = SESSION_RAW;
+   m_FrameIndex = 0;
+   m_Stop = false;
+   m_Recorded = 0;
+   m_Dropped = 0;
+   m_Bytes = 0;
+}
+
+SessionRecorder::~SessionRecorder() {
+   close();
+}
+
+bool SessionRecorder::open(const string& file, SessionEncoding encoding, int slots) {
+   close();
+   m_File = fopen(file.c_str(), "wb");
+   if (!m_File) {
+      LOG_ERROR("Cannot create the session file %s", file.c_str());
+      return false;
+   }
+
+   SessionFileHeader header;
+   memset(&header, 0, sizeof(header));
+   header.magic = SESSION_FILE_MAGIC;
+   header.version = SESSION_VERSION;
+   header.alignment = SESSION_ALIGNMENT;
+   header.headerSize = sizeof(SessionFileHeader);
+   header.startTimeNs = monotonicNanoseconds();
+   fwrite(&header, sizeof(header), 1, m_File);
+
+   m_Encoding = encoding;
+   m_FrameIndex = 0;
+   m_Recorded = m_Dropped = 0;
+   m_Bytes = sizeof(header);
+
+   // slots are sized for a 1080p colour frame up front, larger frames grow them once
+   m_Slots.assign(slots, vector<uchar>());
+   m_Free.clear();
+   m_Filled.clear();
+   for (int s = 0; s < slots; s++) {
+      m_Slots[s].reserve(1920 * 1080 * 3 + 4096);
+      m_Free.push_back(s);
+   }
+
+   m_Stop = false;
+   m_Thread = thread(&SessionRecorder::run, this);
+   return true;
+}
+
+void SessionRecorder::close() {
+   if (!m_File)
+      return;
+   {
+      lock_guard<mutex> lock(m_Mutex);
+      m_Stop = true;
+   }
+   m_Cond.notify_one();
+   m_Thread.join();
+   fclose(m_File);
+   m_File = NULL;
+   m_Slots.clear();
+}
+
+bool SessionRecorder::isOpen() const {
+   return m_File != NULL;
+}
+
+bool SessionRecorder::record(const cv::Mat& frame, int64_t timestampNs, const vector<aruco::Marker>& markers,
+                             const float stageMs[SESSION_STAGES]) {
+   if (!m_File)
+      return false;
+
+   int s;
+   {
+      lock_guard<mutex> lock(m_Mutex);
+      if (m_Free.empty()) {
+         m_Dropped++;
+         return false;
+      }
+      s = m_Free.front();
+      m_Free.pop_front();
+   }
+
+   // header, markers and packed rows in one block
+   bool withImage = m_Encoding != SESSION_NO_IMAGE && !frame.empty();
+   size_t rowBytes = frame.cols * frame.elemSize();
+   size_t imageOffset = alignSession(sizeof(SessionRecordHeader) + markers.size() * sizeof(SessionMarker));
+   size_t imageBytes = withImage ? rowBytes * frame.rows : 0;
+   vector<uchar>& slot = m_Slots[s];
+   slot.resize(alignSession(imageOffset + imageBytes));
+
+   SessionRecordHeader* header = (SessionRecordHeader*)&slot[0];
+   memset(header, 0, imageOffset);
+   header->magic = SESSION_RECORD_MAGIC;
+   header->size = uint32_t(slot.size());
+   header->frameIndex = m_FrameIndex++;
+   header->timestampNs = timestampNs;
+   header->width = frame.cols;
+   header->height = frame.rows;
+   header->type = frame.type();
+   header->stride = int32_t(rowBytes);
+   header->encoding = withImage ? SESSION_RAW : SESSION_NO_IMAGE;
+   header->imageBytes = uint32_t(imageBytes);
+   header->imageOffset = uint32_t(imageOffset);
+   header->markerCount = uint32_t(markers.size());
+   for (int k = 0; k < SESSION_STAGES; k++)
+      header->stageMs[k] = stageMs ? stageMs[k] : 0;
+
+   SessionMarker* out = (SessionMarker*)(&slot[0] + sizeof(SessionRecordHeader));
+   for (size_t m = 0; m < markers.size(); m++) {
+      const aruco::Marker& marker = markers[m];
+      out[m].id = marker.id;
+      for (size_t k = 0; k < 4 && k < marker.size(); k++) {
+         out[m].corners[2 * k] = marker[k].x;
+         out[m].corners[2 * k + 1] = marker[k].y;
+      }
+      bool hasPose = marker.Rvec.total() == 3 && marker.Tvec.total() == 3 && marker.Rvec.type() == CV_32F;
+      for (int k = 0; k < 3; k++) {
+         out[m].rvec[k] = hasPose ? marker.Rvec.ptr<float>(0)[k] : 0;
+         out[m].tvec[k] = hasPose ? marker.Tvec.ptr<float>(0)[k] : 0;
+      }
+   }
+
+   for (int y = 0; withImage && y < frame.rows; y++)
+      memcpy(&slot[imageOffset + y * rowBytes], frame.ptr(y), rowBytes);
+
+   {
+      lock_guard<mutex> lock(m_Mutex);
+      m_Filled.push_back(s);
+   }
+   m_Cond.notify_one();
+   return true;
+}
+
+// Compresses the image of a slot if asked, then appends the record to the file
+void SessionRecorder::writeSlot(vector<uchar>& slot, vector<uchar>& encoded) {
+   SessionRecordHeader* header = (SessionRecordHeader*)&slot[0];
+   if (m_Encoding == SESSION_PNG && header->encoding == SESSION_RAW) {
+      // YUYV is stored as a single channel image twice as wide
+      cv::Mat image(header->height, header->width, header->type, &slot[header->imageOffset], header->stride);
+      if (image.channels() == 2)
+         image = image.reshape(1);
+      if (cv::imencode(".png", image, encoded)) {
+         header->encoding = SESSION_PNG;
+         header->imageBytes = uint32_t(encoded.size());
+         header->size = uint32_t(alignSession(header->imageOffset + encoded.size()));
+         fwrite(&slot[0], header->imageOffset, 1, m_File);
+         fwrite(&encoded[0], encoded.size(), 1, m_File);
+         static const uchar padding[SESSION_ALIGNMENT] = { 0 };
+         fwrite(padding, header->size - header->imageOffset - encoded.size(), 1, m_File);
+         m_Bytes += header->size;
+         m_Recorded++;
+         return;
+      }
+   }
+   fwrite(&slot[0], slot.size(), 1, m_File);
+   m_Bytes += slot.size();
+   m_Recorded++;
+}
+
+void SessionRecorder::run() {
+   vector<uchar> encoded;
+   for (;;) {
+      int s;
+      {
+         unique_lock<mutex> lock(m_Mutex);
+         m_Cond.wait(lock, [this] { return m_Stop || !m_Filled.empty(); });
+         if (m_Filled.empty()) {
+            fflush(m_File);
+            return;
+         }
+         s = m_Filled.front();
+         m_Filled.pop_front();
+      }
+
+      writeSlot(m_Slots[s], encoded);
+
+      lock_guard<mutex> lock(m_Mutex);
+      m_Free.push_back(s);
+   }
+}
@@ -0,0 +1,129 @@
+//
+//  SessionRecorder.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_SessionRecorder_h
+#define UserPerspectiveAR_SessionRecorder_h
+
+#include <opencv2/core/core.hpp>
+#include "aruco/aruco.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Session file layout (little endian):
+//    SessionFileHeader
+//    records, one per frame, each starting on a SESSION_ALIGNMENT boundary:
+//       SessionRecordHeader
+//       SessionMarker x markerCount
+//       image (imageBytes at imageOffset from the record start)
+// Records are self-delimited (magic + size), so a file cut by a crash is readable
+// up to its last complete record.
+
+#define SESSION_FILE_MAGIC    0x53455341u    // "ASES"
+#define SESSION_RECORD_MAGIC  0x454D5246u    // "FRME"
+#define SESSION_VERSION       1
+#define SESSION_ALIGNMENT     16
+
+// Stage timings stored with every frame (milliseconds)
+enum SessionStage {
+   STAGE_CAPTURE,       // waiting for the camera
+   STAGE_PROCESS,       // detection and poses
+   STAGE_DRAW,          // drawScene
+   STAGE_FRAME,         // whole previous loop iteration
+   SESSION_STAGES
+};
+
+enum SessionEncoding {
+   SESSION_RAW,         // pixels as captured, rows packed
+   SESSION_PNG,         // lossless, compressed by the writer thread
+   SESSION_NO_IMAGE     // detections only
+};
+
+struct SessionFileHeader {
+   uint32_t    magic;
+   uint32_t    version;
+   uint32_t    alignment;
+   uint32_t    headerSize;
+   int64_t     startTimeNs;
+   int64_t     reserved;
+};
+
+struct SessionRecordHeader {
+   uint32_t    magic;
+   uint32_t    size;          // whole record with padding
+   uint64_t    frameIndex;
+   int64_t     timestampNs;   // capture time (monotonic clock)
+   int32_t     width;
+   int32_t     height;
+   int32_t     type;          // OpenCV type of the frame (CV_8UC2 for YUYV)
+   int32_t     stride;        // bytes per row of a raw image
+   uint32_t    encoding;
+   uint32_t    imageBytes;
+   uint32_t    imageOffset;
+   uint32_t    markerCount;
+   float       stageMs[SESSION_STAGES];
+   uint32_t    reserved[2];
+};
+
+struct SessionMarker {
+   int32_t     id;
+   float       corners[8];
+   float       rvec[3];
+   float       tvec[3];
+};
+
+// Appends frames and their results to a session file.
+// record() only copies into a preallocated slot; compression and disk writes happen in a
+// background thread, so recording does not change the frame times it records.
+class SessionRecorder {
+public:
+   SessionRecorder();
+   ~SessionRecorder();
+
+   bool     open(const std::string& file, SessionEncoding encoding = SESSION_RAW, int slots = 8);
+   // Writes the pending frames and closes the file
+   void     close();
+   bool     isOpen() const;
+
+   // Queues a frame, never blocks: when every slot is still waiting for the disk the
+   // frame is dropped (and counted)
+   bool     record(const cv::Mat& frame, int64_t timestampNs, const std::vector<aruco::Marker>& markers,
+                   const float stageMs[SESSION_STAGES]);
+
+   uint64_t recordedFrames() const { return m_Recorded; }
+   uint64_t droppedFrames() const { return m_Dropped; }
+   uint64_t bytesWritten() const { return m_Bytes; }
+
+private:
+   void     run();
+   void     writeSlot(std::vector<uchar>& slot, std::vector<uchar>& encoded);
+
+   FILE*                      m_File;
+   SessionEncoding            m_Encoding;
+   uint64_t                   m_FrameIndex;
+
+   // Slots go from m_Free to m_Filled (main thread) and back (writer thread)
+   std::vector<std::vector<uchar> > m_Slots;
+   std::deque<int>            m_Free;
+   std::deque<int>            m_Filled;
+   std::mutex                 m_Mutex;
+   std::condition_variable    m_Cond;
+   std::thread                m_Thread;
+   bool                       m_Stop;
+
+   std::atomic<uint64_t>      m_Recorded;
+   std::atomic<uint64_t>      m_Dropped;
+   std::atomic<uint64_t>      m_Bytes;
+};
+
+#endif
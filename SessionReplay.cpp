@@ -0,0 +1,169 @@
+//
+//  SessionReplay.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "SessionReplay.h"
+#include "SimClock.h"
+#include "Logger.h"
+
+#include <opencv2/imgcodecs.hpp>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+SessionReplay::SessionReplay() {
+   m_Next = 0;
+   m_Realtime = false;
+   m_ReplayStart = m_RecordStart = -1;
+}
+
+bool SessionReplay::open(const string& file) {
+   release();
+   if (!m_Map.open(file)) {
+      LOG_ERROR("Cannot open the session %s", file.c_str());
+      return false;
+   }
+
+   const SessionFileHeader* header = (const SessionFileHeader*)m_Map.data();
+   if (m_Map.size() < sizeof(SessionFileHeader) || header->magic != SESSION_FILE_MAGIC ||
+       header->version != SESSION_VERSION || header->alignment != SESSION_ALIGNMENT) {
+      LOG_ERROR("%s is not a session file", file.c_str());
+      m_Map.close();
+      return false;
+   }
+
+   // Index: records follow each other, the first invalid one ends the session
+   // (a recording interrupted in the middle of a write)
+   size_t offset = header->headerSize;
+   while (offset + sizeof(SessionRecordHeader) <= m_Map.size()) {
+      const SessionRecordHeader* record = (const SessionRecordHeader*)(m_Map.data() + offset);
+      if (record->magic != SESSION_RECORD_MAGIC || record->size < sizeof(SessionRecordHeader) ||
+          offset + record->size > m_Map.size() || size_t(record->imageOffset) + record->imageBytes > record->size)
+         break;
+      m_Offsets.push_back(offset);
+      offset += record->size;
+   }
+   if (offset != m_Map.size())
+      LOG_WARNING("Session %s is truncated after %u frames", file.c_str(), unsigned(m_Offsets.size()));
+   return true;
+}
+
+void SessionReplay::release() {
+   m_Map.close();
+   m_Offsets.clear();
+   m_Decoded.release();
+   m_Next = 0;
+   m_ReplayStart = m_RecordStart = -1;
+}
+
+bool SessionReplay::isOpened() const {
+   return m_Map.isOpen();
+}
+
+size_t SessionReplay::frameCount() const {
+   return m_Offsets.size();
+}
+
+bool SessionReplay::seek(size_t index) {
+   if (index >= m_Offsets.size())
+      return false;
+   m_Next = index;
+   // pacing starts again from the new frame
+   m_ReplayStart = m_RecordStart = -1;
+   return true;
+}
+
+size_t SessionReplay::position() const {
+   return m_Next;
+}
+
+void SessionReplay::setRealtime(bool realtime) {
+   m_Realtime = realtime;
+   m_ReplayStart = m_RecordStart = -1;
+}
+
+const SessionRecordHeader* SessionReplay::recordAt(size_t index) const {
+   if (index >= m_Offsets.size())
+      return NULL;
+   return (const SessionRecordHeader*)(m_Map.data() + m_Offsets[index]);
+}
+
+bool SessionReplay::frameAt(size_t index, cv::Mat& frame, int64_t& timestampNs) {
+   const SessionRecordHeader* record = recordAt(index);
+   if (!record)
+      return false;
+   timestampNs = record->timestampNs;
+   unsigned char* image = m_Map.data() + m_Offsets[index] + record->imageOffset;
+
+   switch (record->encoding) {
+   case SESSION_RAW:
+      frame = cv::Mat(record->height, record->width, record->type, image, record->stride);
+      return true;
+
+   case SESSION_PNG: {
+      cv::Mat encoded(1, int(record->imageBytes), CV_8UC1, image);
+      m_Decoded = cv::imdecode(encoded, cv::IMREAD_UNCHANGED);
+      // 2 channel frames (YUYV) were stored as single channel images twice as wide
+      if (!m_Decoded.empty() && m_Decoded.channels() != CV_MAT_CN(record->type))
+         m_Decoded = m_Decoded.reshape(CV_MAT_CN(record->type));
+      frame = m_Decoded;
+      return !frame.empty();
+   }
+
+   default:
+      // detections only
+      frame.release();
+      return true;
+   }
+}
+
+bool SessionReplay::markersAt(size_t index, vector<aruco::Marker>& markers, float markerSize) const {
+   markers.clear();
+   const SessionRecordHeader* record = recordAt(index);
+   if (!record)
+      return false;
+
+   const SessionMarker* in = (const SessionMarker*)((const unsigned char*)record + sizeof(SessionRecordHeader));
+   for (uint32_t m = 0; m < record->markerCount; m++) {
+      vector<cv::Point2f> corners(4);
+      for (int k = 0; k < 4; k++)
+         corners[k] = cv::Point2f(in[m].corners[2 * k], in[m].corners[2 * k + 1]);
+      aruco::Marker marker(corners, in[m].id);
+      marker.Rvec.create(3, 1, CV_32F);
+      marker.Tvec.create(3, 1, CV_32F);
+      for (int k = 0; k < 3; k++) {
+         marker.Rvec.ptr<float>(0)[k] = in[m].rvec[k];
+         marker.Tvec.ptr<float>(0)[k] = in[m].tvec[k];
+      }
+      marker.ssize = markerSize;
+      markers.push_back(marker);
+   }
+   return true;
+}
+
+bool SessionReplay::read(cv::Mat& frame, int64_t& timestampNs) {
+   if (m_Next >= m_Offsets.size() || !frameAt(m_Next, frame, timestampNs))
+      return false;
+   m_Next++;
+
+   if (m_Realtime) {
+      // as long after the first frame replayed as during the recording
+      int64_t now = monotonicNanoseconds();
+      if (m_ReplayStart < 0) {
+         m_ReplayStart = now;
+         m_RecordStart = timestampNs;
+      }
+      int64_t wait = (timestampNs - m_RecordStart) - (now - m_ReplayStart);
+      if (wait > 0)
+         this_thread::sleep_for(chrono::nanoseconds(wait));
+   }
+   return true;
+}
+
+cv::Size SessionReplay::frameSize() const {
+   const SessionRecordHeader* record = recordAt(m_Next < m_Offsets.size() ? m_Next : 0);
+   return record ? cv::Size(record->width, record->height) : cv::Size();
+}
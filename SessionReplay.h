@@ -0,0 +1,56 @@
+//
+//  SessionReplay.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_SessionReplay_h
+#define UserPerspectiveAR_SessionReplay_h
+
+#include "FrameSource.h"
+#include "MappedFile.h"
+#include "SessionRecorder.h"
+
+#include <vector>
+
+// Plays back a session file written by SessionRecorder.
+// The file is mapped in memory and indexed once; raw frames are returned as views over
+// the mapping (no copy, no decoding), PNG frames are decoded. Frames come as fast as
+// they are asked for unless real time pacing is enabled.
+class SessionReplay : public FrameSource {
+public:
+   SessionReplay();
+
+   bool     open(const std::string& file);
+   void     release();
+   bool     isOpened() const;
+
+   size_t   frameCount() const;
+   // Index of the frame the next read() returns
+   bool     seek(size_t index);
+   size_t   position() const;
+
+   // Waits between frames as long as during the recording
+   void     setRealtime(bool realtime);
+
+   bool     read(cv::Mat& frame, int64_t& timestampNs);
+   cv::Size frameSize() const;
+
+   // Random access. Views stay valid until release(), a decoded frame until the next call.
+   const SessionRecordHeader* recordAt(size_t index) const;
+   bool     frameAt(size_t index, cv::Mat& frame, int64_t& timestampNs);
+   // Markers recorded with a frame, with the poses of a markerSize marker
+   bool     markersAt(size_t index, std::vector<aruco::Marker>& markers, float markerSize) const;
+
+private:
+   MappedFile           m_Map;
+   // offset of each record in the file
+   std::vector<size_t>  m_Offsets;
+   size_t               m_Next;
+   bool                 m_Realtime;
+   int64_t              m_ReplayStart;
+   int64_t              m_RecordStart;
+   cv::Mat              m_Decoded;
+};
+
+#endif
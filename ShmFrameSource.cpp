@@ -0,0 +1,172 @@
+//
+//  ShmFrameSource.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "ShmFrameSource.h"
+#include "SimClock.h"
+#include "Logger.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+static_assert(FRAME_SHM_BGR == PIXEL_FORMAT_BGR && FRAME_SHM_GREY == PIXEL_FORMAT_GREY &&
+              FRAME_SHM_YUYV == PIXEL_FORMAT_YUYV && FRAME_SHM_NV12 == PIXEL_FORMAT_NV12,
+              "FrameShm.h formats must match PixelFormat");
+
+ShmFrameSource::ShmFrameSource() {
+   m_Header = NULL;
+   m_Size = 0;
+#ifdef _WIN32
+   m_Mapping = NULL;
+#endif
+   m_Slot = -1;
+   m_TimeoutMs = 2000;
+   m_Dropped = 0;
+}
+
+ShmFrameSource::~ShmFrameSource() {
+   release();
+}
+
+bool ShmFrameSource::open(const string& name) {
+   release();
+
+#ifdef _WIN32
+   // Windows names cannot start with a slash
+   HANDLE mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name[0] == '/' ? name.c_str() + 1 : name.c_str());
+   void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0) : NULL;
+   MEMORY_BASIC_INFORMATION info;
+   if (!data || !VirtualQuery(data, &info, sizeof(info))) {
+      if (data)
+         UnmapViewOfFile(data);
+      if (mapping)
+         CloseHandle(mapping);
+      LOG_ERROR("Cannot open the frame ring %s", name.c_str());
+      return false;
+   }
+   m_Mapping = mapping;
+   size_t size = info.RegionSize;
+#else
+   int fd = shm_open(name.c_str(), O_RDWR, 0);
+   struct stat st;
+   if (fd < 0 || fstat(fd, &st) != 0) {
+      if (fd >= 0)
+         ::close(fd);
+      LOG_ERROR("Cannot open the frame ring %s", name.c_str());
+      return false;
+   }
+   size_t size = size_t(st.st_size);
+   void* data = size >= sizeof(FrameShmHeader) ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+   ::close(fd);
+   if (data == MAP_FAILED) {
+      LOG_ERROR("Cannot map the frame ring %s", name.c_str());
+      return false;
+   }
+#endif
+   m_Header = (FrameShmHeader*)data;
+   m_Size = size;
+
+   // The slots must lie inside the mapping, they are trusted afterwards
+   bool valid = size >= sizeof(FrameShmHeader) && frame_shm_load32(&m_Header->magic) == FRAME_SHM_MAGIC &&
+                m_Header->version == FRAME_SHM_VERSION && m_Header->slotCount > 0 &&
+                m_Header->slotCount <= FRAME_SHM_MAX_SLOTS && m_Header->totalBytes <= size;
+   for (uint32_t s = 0; valid && s < m_Header->slotCount; s++)
+      valid = m_Header->slots[s].offset + m_Header->slotBytes <= m_Header->totalBytes;
+   if (!valid) {
+      LOG_ERROR("%s is not a frame ring", name.c_str());
+      release();
+      return false;
+   }
+   return true;
+}
+
+void ShmFrameSource::release() {
+   if (!m_Header)
+      return;
+   if (m_Slot >= 0)
+      frame_shm_end_read(m_Header, m_Slot);
+   m_Slot = -1;
+#ifdef _WIN32
+   UnmapViewOfFile(m_Header);
+   CloseHandle(m_Mapping);
+   m_Mapping = NULL;
+#else
+   munmap(m_Header, m_Size);
+#endif
+   m_Header = NULL;
+   m_Size = 0;
+}
+
+bool ShmFrameSource::isOpened() const {
+   return m_Header != NULL;
+}
+
+bool ShmFrameSource::read(cv::Mat& frame, int64_t& timestampNs) {
+   if (!m_Header)
+      return false;
+
+   // The previous view is no longer used: its slot goes back to the producer
+   frame.release();
+   if (m_Slot >= 0)
+      frame_shm_end_read(m_Header, m_Slot);
+   m_Slot = -1;
+
+   int64_t deadline = monotonicNanoseconds() + int64_t(m_TimeoutMs) * 1000000;
+   for (;;) {
+      m_Slot = frame_shm_begin_read(m_Header, &m_Dropped);
+      if (m_Slot < 0) {
+         if (monotonicNanoseconds() > deadline) {
+            LOG_WARNING("No frame from the producer for %d ms", m_TimeoutMs);
+            return false;
+         }
+         this_thread::sleep_for(chrono::microseconds(100));
+         continue;
+      }
+
+      const FrameShmSlot& slot = m_Header->slots[m_Slot];
+      int type = CV_8UC3, rows = slot.height;
+      switch (slot.format) {
+      case FRAME_SHM_GREY: type = CV_8UC1; break;
+      case FRAME_SHM_YUYV: type = CV_8UC2; break;
+      case FRAME_SHM_NV12: type = CV_8UC1; rows = slot.height * 3 / 2; break;
+      }
+      if (slot.format <= FRAME_SHM_NV12 && slot.width > 0 && rows > 0 &&
+          slot.stride >= slot.width * int(CV_ELEM_SIZE(type)) && uint64_t(slot.stride) * rows <= m_Header->slotBytes) {
+         frame = cv::Mat(rows, slot.width, type, frame_shm_pixels(m_Header, m_Slot), size_t(slot.stride));
+         timestampNs = slot.timestampNs;
+         return true;
+      }
+
+      // A frame that does not fit its slot is skipped
+      LOG_WARNING_EVERY(1.0, "Invalid frame %dx%d, stride %d, format %u", slot.width, slot.height, slot.stride, slot.format);
+      frame_shm_end_read(m_Header, m_Slot);
+      m_Slot = -1;
+   }
+}
+
+cv::Size ShmFrameSource::frameSize() const {
+   if (!m_Header)
+      return cv::Size();
+   if (m_Slot >= 0)
+      return cv::Size(m_Header->slots[m_Slot].width, m_Header->slots[m_Slot].height);
+   return cv::Size(m_Header->width, m_Header->height);
+}
+
+PixelFormat ShmFrameSource::pixelFormat(const cv::Mat& frame) const {
+   if (m_Slot >= 0)
+      return PixelFormat(m_Header->slots[m_Slot].format);
+   return FrameSource::pixelFormat(frame);
+}
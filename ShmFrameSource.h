@@ -0,0 +1,53 @@
+//
+//  ShmFrameSource.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_ShmFrameSource_h
+#define UserPerspectiveAR_ShmFrameSource_h
+
+#include "FrameSource.h"
+#include "FrameShm.h"
+
+#include <string>
+
+// Frames written by another process in a shared memory ring (layout in FrameShm.h).
+// read() returns a view over the slot's pixels and keeps the slot until the next read(),
+// so frames reach the detection without any copy. Only the newest frame is read,
+// frames that arrived in between are given back to the producer.
+class ShmFrameSource : public FrameSource {
+public:
+   ShmFrameSource();
+   ~ShmFrameSource();
+
+   // Attaches to the region created by the producer (POSIX name such as "/aruco_frames")
+   bool        open(const std::string& name);
+   void        release();
+   bool        isOpened() const;
+
+   // How long read() waits for a frame before giving up
+   void        setTimeout(int timeoutMs) { m_TimeoutMs = timeoutMs; }
+
+   bool        read(cv::Mat& frame, int64_t& timestampNs);
+   cv::Size    frameSize() const;
+   PixelFormat pixelFormat(const cv::Mat& frame) const;
+
+   uint64_t    droppedFrames() const { return m_Dropped; }
+
+private:
+   ShmFrameSource(const ShmFrameSource&);
+   ShmFrameSource& operator=(const ShmFrameSource&);
+
+   FrameShmHeader* m_Header;
+   size_t      m_Size;
+#ifdef _WIN32
+   void*       m_Mapping;
+#endif
+   // slot read last, -1 if none
+   int         m_Slot;
+   int         m_TimeoutMs;
+   uint64_t    m_Dropped;
+};
+
+#endif
@@ -0,0 +1,43 @@
+//
+//  SimClock.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "SimClock.h"
+
+int64_t monotonicNanoseconds() {
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+SimClock::SimClock() {
+   m_FixedStep = 0;
+   reset();
+}
+
+void SimClock::setFixedStep(double step) {
+   m_FixedStep = step > 0 ? step : 0;
+   reset();
+}
+
+double SimClock::getFixedStep() const {
+   return m_FixedStep;
+}
+
+double SimClock::tick() {
+   if (m_FixedStep > 0)
+      m_Time += m_FixedStep;
+   else
+      m_Time = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_Start).count();
+   return m_Time;
+}
+
+double SimClock::now() const {
+   return m_Time;
+}
+
+void SimClock::reset() {
+   m_Time = 0;
+   m_Start = std::chrono::steady_clock::now();
+}
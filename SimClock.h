@@ -0,0 +1,43 @@
+//
+//  SimClock.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_SimClock_h
+#define UserPerspectiveAR_SimClock_h
+
+#include <chrono>
+#include <stdint.h>
+
+// Monotonic time in nanoseconds, for timestamps that can be compared across threads
+int64_t monotonicNanoseconds();
+
+// Clock driving the animation of the scene.
+// By default it follows the monotonic clock so that the animation speed does not depend
+// on the frame rate. With a fixed step it advances by exactly that step per tick, which
+// makes benchmark and replay runs reproducible bit for bit.
+class SimClock {
+public:
+   SimClock();
+
+   // Fixed step in seconds per tick, 0 goes back to the monotonic clock
+   void     setFixedStep(double step);
+   double   getFixedStep() const;
+
+   // Advances the clock (once per rendered frame) and returns the simulation time in seconds
+   double   tick();
+
+   // Simulation time of the last tick
+   double   now() const;
+
+   // Back to time 0
+   void     reset();
+
+private:
+   double                                 m_FixedStep;
+   double                                 m_Time;
+   std::chrono::steady_clock::time_point  m_Start;
+};
+
+#endif
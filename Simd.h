@@ -0,0 +1,16 @@
+//
+//  Simd.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_Simd_h
+#define UserPerspectiveAR_Simd_h
+
+// SSE2 is always there on x64 (and with /arch:SSE2 on x86), other targets use the scalar code
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ARUCO_SSE2
+#endif
+
+#endif
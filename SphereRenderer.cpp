@@ -0,0 +1,272 @@
+//
+//  SphereRenderer.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "SphereRenderer.h"
+#include "Logger.h"
+
+#include <math.h>
+
+#define PI  3.14159265358979323846
+
+// Shaders of the instanced path: fixed-function inputs, model-view taken per instance
+static const char* instancedVertexShader =
+   "#version 150 compatibility\n"
+   "in mat4 modelView;\n"
+   "out vec2 uv;\n"
+   "void main() {\n"
+   "   uv = gl_MultiTexCoord0.st;\n"
+   "   gl_Position = gl_ProjectionMatrix * modelView * gl_Vertex;\n"
+   "}\n";
+
+static const char* instancedFragmentShader =
+   "#version 150 compatibility\n"
+   "uniform sampler2D planetTexture;\n"
+   "in vec2 uv;\n"
+   "void main() {\n"
+   "   gl_FragColor = texture(planetTexture, uv);\n"
+   "}\n";
+
+const char* renderPathName(RenderPath path) {
+   switch (path) {
+   case RENDER_VBO:        return "vbo";
+   case RENDER_INSTANCED:  return "instanced";
+   default:                return "legacy";
+   }
+}
+
+SphereRenderer::SphereRenderer(int slices, int stacks) {
+   m_Slices = slices;
+   m_Stacks = stacks;
+   m_Path = RENDER_LEGACY;
+   m_Quadric = NULL;
+   m_VertexBuffer = m_IndexBuffer = m_InstanceBuffer = 0;
+   m_Program = 0;
+   m_ModelViewAttrib = -1;
+   m_InstanceCapacity = 0;
+}
+
+SphereRenderer::~SphereRenderer() {
+   if (m_Quadric)
+      gluDeleteQuadric(m_Quadric);
+}
+
+RenderPath SphereRenderer::setPath(RenderPath path) {
+   GLExt::load();
+   if (path == RENDER_INSTANCED && !(GLExt::hasInstancing() && createBuffers() && createProgram())) {
+      LOG_WARNING("Instanced rendering not available, using VBOs");
+      path = RENDER_VBO;
+   }
+   if (path == RENDER_VBO && !(GLExt::hasBuffers() && createBuffers())) {
+      LOG_WARNING("Vertex buffers not available, using immediate mode");
+      path = RENDER_LEGACY;
+   }
+   m_Path = path;
+   return m_Path;
+}
+
+RenderPath SphereRenderer::getPath() const {
+   return m_Path;
+}
+
+// Unit sphere around z with gluSphere's layout: x = sin(phi) sin(theta), y = sin(phi) cos(theta),
+// z = cos(phi), texture s = 1 - theta / 2pi and t = 1 - phi / pi
+void SphereRenderer::buildMesh() {
+   m_Vertices.clear();
+   m_Indices.clear();
+   for (int j = 0; j <= m_Stacks; j++) {
+      double phi = PI * j / m_Stacks;
+      for (int i = 0; i <= m_Slices; i++) {
+         double theta = 2 * PI * i / m_Slices;
+         Vertex v;
+         v.normal[0] = v.position[0] = float(sin(phi) * sin(theta));
+         v.normal[1] = v.position[1] = float(sin(phi) * cos(theta));
+         v.normal[2] = v.position[2] = float(cos(phi));
+         v.uv[0] = 1.0f - float(i) / m_Slices;
+         v.uv[1] = 1.0f - float(j) / m_Stacks;
+         m_Vertices.push_back(v);
+      }
+   }
+
+   for (int j = 0; j < m_Stacks; j++) {
+      for (int i = 0; i < m_Slices; i++) {
+         unsigned short a = (unsigned short)(j * (m_Slices + 1) + i), b = (unsigned short)(a + m_Slices + 1);
+         unsigned short quad[2][3] = { { a, b, (unsigned short)(a + 1) }, { (unsigned short)(a + 1), b, (unsigned short)(b + 1) } };
+         for (int t = 0; t < 2; t++) {
+            // counter-clockwise seen from outside, for back face culling
+            const float* p0 = m_Vertices[quad[t][0]].position;
+            const float* p1 = m_Vertices[quad[t][1]].position;
+            const float* p2 = m_Vertices[quad[t][2]].position;
+            float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            float dot = n[0] * (p0[0] + p1[0] + p2[0]) + n[1] * (p0[1] + p1[1] + p2[1]) + n[2] * (p0[2] + p1[2] + p2[2]);
+            if (n[0] == 0 && n[1] == 0 && n[2] == 0)
+               continue;   // degenerate triangle at a pole
+            m_Indices.push_back(quad[t][0]);
+            m_Indices.push_back(dot > 0 ? quad[t][1] : quad[t][2]);
+            m_Indices.push_back(dot > 0 ? quad[t][2] : quad[t][1]);
+         }
+      }
+   }
+}
+
+bool SphereRenderer::createBuffers() {
+   if (m_VertexBuffer)
+      return true;
+   buildMesh();
+
+   GLuint buffers[3];
+   GLExt::GenBuffers(3, buffers);
+   m_VertexBuffer = buffers[0];
+   m_IndexBuffer = buffers[1];
+   m_InstanceBuffer = buffers[2];
+
+   GLExt::BindBuffer(GL_ARRAY_BUFFER, m_VertexBuffer);
+   GLExt::BufferData(GL_ARRAY_BUFFER, m_Vertices.size() * sizeof(Vertex), &m_Vertices[0], GL_STATIC_DRAW);
+   GLExt::BindBuffer(GL_ARRAY_BUFFER, 0);
+   GLExt::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IndexBuffer);
+   GLExt::BufferData(GL_ELEMENT_ARRAY_BUFFER, m_Indices.size() * sizeof(unsigned short), &m_Indices[0], GL_STATIC_DRAW);
+   GLExt::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+   return true;
+}
+
+static GLuint compileShader(GLenum type, const char* source) {
+   GLuint shader = GLExt::CreateShader(type);
+   GLExt::ShaderSource(shader, 1, &source, NULL);
+   GLExt::CompileShader(shader);
+   GLint ok = 0;
+   GLExt::GetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+   if (!ok) {
+      char log[1024];
+      GLExt::GetShaderInfoLog(shader, sizeof(log), NULL, log);
+      LOG_ERROR("Shader compilation failed: %s", log);
+      GLExt::DeleteShader(shader);
+      return 0;
+   }
+   return shader;
+}
+
+bool SphereRenderer::createProgram() {
+   if (m_Program)
+      return true;
+   GLuint vertex = compileShader(GL_VERTEX_SHADER, instancedVertexShader);
+   GLuint fragment = compileShader(GL_FRAGMENT_SHADER, instancedFragmentShader);
+   if (!vertex || !fragment)
+      return false;
+
+   GLuint program = GLExt::CreateProgram();
+   GLExt::AttachShader(program, vertex);
+   GLExt::AttachShader(program, fragment);
+   GLExt::LinkProgram(program);
+   GLExt::DeleteShader(vertex);
+   GLExt::DeleteShader(fragment);
+   GLint ok = 0;
+   GLExt::GetProgramiv(program, GL_LINK_STATUS, &ok);
+   m_ModelViewAttrib = GLExt::GetAttribLocation(program, "modelView");
+   if (!ok || m_ModelViewAttrib < 0)
+      return false;
+
+   GLExt::UseProgram(program);
+   GLExt::Uniform1i(GLExt::GetUniformLocation(program, "planetTexture"), 0);
+   GLExt::UseProgram(0);
+   m_Program = program;
+   return true;
+}
+
+void SphereRenderer::bindMesh() {
+   GLExt::BindBuffer(GL_ARRAY_BUFFER, m_VertexBuffer);
+   GLExt::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IndexBuffer);
+   glEnableClientState(GL_VERTEX_ARRAY);
+   glEnableClientState(GL_NORMAL_ARRAY);
+   glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+   glVertexPointer(3, GL_FLOAT, sizeof(Vertex), (const void*)offsetof(Vertex, position));
+   glNormalPointer(GL_FLOAT, sizeof(Vertex), (const void*)offsetof(Vertex, normal));
+   glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), (const void*)offsetof(Vertex, uv));
+}
+
+void SphereRenderer::unbindMesh() {
+   glDisableClientState(GL_VERTEX_ARRAY);
+   glDisableClientState(GL_NORMAL_ARRAY);
+   glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+   GLExt::BindBuffer(GL_ARRAY_BUFFER, 0);
+   GLExt::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void SphereRenderer::begin() {
+   glMatrixMode(GL_MODELVIEW);
+   glEnable(GL_TEXTURE_2D);
+   if (m_Path == RENDER_VBO)
+      bindMesh();
+   else if (m_Path == RENDER_INSTANCED) {
+      for (std::map<unsigned int, std::vector<float> >::iterator it = m_Batches.begin(); it != m_Batches.end(); ++it)
+         it->second.clear();
+   }
+}
+
+void SphereRenderer::draw(unsigned int texture, const double modelview[16]) {
+   switch (m_Path) {
+   case RENDER_LEGACY:
+      if (!m_Quadric) {
+         // The quadric is only a set of drawing options, one is enough for all the spheres
+         m_Quadric = gluNewQuadric();
+         gluQuadricTexture(m_Quadric, GL_TRUE);
+      }
+      glLoadMatrixd(modelview);
+      glBindTexture(GL_TEXTURE_2D, texture);
+      gluSphere(m_Quadric, 1.0, m_Slices, m_Stacks);
+      break;
+
+   case RENDER_VBO:
+      glLoadMatrixd(modelview);
+      glBindTexture(GL_TEXTURE_2D, texture);
+      glDrawElements(GL_TRIANGLES, GLsizei(m_Indices.size()), GL_UNSIGNED_SHORT, 0);
+      break;
+
+   case RENDER_INSTANCED: {
+      std::vector<float>& batch = m_Batches[texture];
+      for (int k = 0; k < 16; k++)
+         batch.push_back(float(modelview[k]));
+      break;
+   }
+   }
+}
+
+void SphereRenderer::end() {
+   if (m_Path == RENDER_INSTANCED) {
+      bindMesh();
+      GLExt::UseProgram(m_Program);
+      for (std::map<unsigned int, std::vector<float> >::iterator it = m_Batches.begin(); it != m_Batches.end(); ++it) {
+         const std::vector<float>& batch = it->second;
+         if (batch.empty())
+            continue;
+
+         // the buffer is orphaned each time so that the driver never waits for the previous draw
+         size_t bytes = batch.size() * sizeof(float);
+         m_InstanceCapacity = bytes > m_InstanceCapacity ? bytes : m_InstanceCapacity;
+         GLExt::BindBuffer(GL_ARRAY_BUFFER, m_InstanceBuffer);
+         GLExt::BufferData(GL_ARRAY_BUFFER, m_InstanceCapacity, NULL, GL_STREAM_DRAW);
+         GLExt::BufferSubData(GL_ARRAY_BUFFER, 0, bytes, &batch[0]);
+         for (int c = 0; c < 4; c++) {
+            GLuint attrib = GLuint(m_ModelViewAttrib + c);
+            GLExt::EnableVertexAttribArray(attrib);
+            GLExt::VertexAttribPointer(attrib, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float), (const void*)(c * 4 * sizeof(float)));
+            GLExt::VertexAttribDivisor(attrib, 1);
+         }
+
+         glBindTexture(GL_TEXTURE_2D, it->first);
+         GLExt::DrawElementsInstanced(GL_TRIANGLES, GLsizei(m_Indices.size()), GL_UNSIGNED_SHORT, 0, GLsizei(batch.size() / 16));
+      }
+      for (int c = 0; c < 4; c++) {
+         GLExt::VertexAttribDivisor(GLuint(m_ModelViewAttrib + c), 0);
+         GLExt::DisableVertexAttribArray(GLuint(m_ModelViewAttrib + c));
+      }
+      GLExt::UseProgram(0);
+      unbindMesh();
+   }
+   else if (m_Path == RENDER_VBO)
+      unbindMesh();
+   glDisable(GL_TEXTURE_2D);
+}
@@ -0,0 +1,74 @@
+//
+//  SphereRenderer.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_SphereRenderer_h
+#define UserPerspectiveAR_SphereRenderer_h
+
+#include "GLExt.h"
+#include <GL/GLU.h>
+
+#include <map>
+#include <vector>
+
+// How the planets are sent to the GPU
+enum RenderPath {
+   RENDER_LEGACY,       // gluSphere in immediate mode, every vertex sent each frame
+   RENDER_VBO,          // sphere stored once in buffers, one glDrawElements per body
+   RENDER_INSTANCED     // one glDrawElementsInstanced per texture, matrices as instance attributes
+};
+
+const char* renderPathName(RenderPath path);
+
+// Draws the textured spheres of the scene.
+// A frame is begin(), one draw() per body, end(); the instanced path only draws in end().
+class SphereRenderer {
+public:
+   SphereRenderer(int slices = 20, int stacks = 20);
+   ~SphereRenderer();
+
+   // Needs a current context. Falls back on the legacy path when the context lacks
+   // what the path needs, returns the path in use
+   RenderPath  setPath(RenderPath path);
+   RenderPath  getPath() const;
+
+   void        begin();
+   // Unit sphere placed by an OpenGL (column-major) model-view matrix
+   void        draw(unsigned int texture, const double modelview[16]);
+   void        end();
+
+private:
+   struct Vertex {
+      float    position[3];
+      float    normal[3];
+      float    uv[2];
+   };
+
+   void        buildMesh();
+   bool        createBuffers();
+   bool        createProgram();
+   void        bindMesh();
+   void        unbindMesh();
+
+   int                        m_Slices;
+   int                        m_Stacks;
+   RenderPath                 m_Path;
+   GLUquadric*                m_Quadric;
+
+   // Same tessellation as gluSphere, for the buffer paths
+   std::vector<Vertex>        m_Vertices;
+   std::vector<unsigned short> m_Indices;
+   GLuint                     m_VertexBuffer;
+   GLuint                     m_IndexBuffer;
+
+   // Instancing: model-view matrices batched by texture
+   GLuint                     m_Program;
+   GLint                      m_ModelViewAttrib;
+   GLuint                     m_InstanceBuffer;
+   size_t                     m_InstanceCapacity;
+   std::map<unsigned int, std::vector<float> > m_Batches;
+};
+
+#endif
@@ -0,0 +1,72 @@
+//
+//  TextureLoader.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "TextureLoader.h"
+#include "stb_image.h"
+
+#include <iostream>
+
+TextureLoader::TextureLoader() {
+   m_Stop = false;
+   m_Thread = std::thread(&TextureLoader::run, this);
+}
+
+TextureLoader::~TextureLoader() {
+   {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Stop = true;
+   }
+   m_Cond.notify_one();
+   m_Thread.join();
+}
+
+void TextureLoader::request(const std::string& file) {
+   {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Requests.push_back(file);
+   }
+   m_Cond.notify_one();
+}
+
+bool TextureLoader::take(DecodedTexture& texture) {
+   std::lock_guard<std::mutex> lock(m_Mutex);
+   if (m_Ready.empty())
+      return false;
+   texture = std::move(m_Ready.front());
+   m_Ready.pop_front();
+   return true;
+}
+
+void TextureLoader::run() {
+   for (;;) {
+      std::string file;
+      {
+         std::unique_lock<std::mutex> lock(m_Mutex);
+         m_Cond.wait(lock, [this] { return m_Stop || !m_Requests.empty(); });
+         if (m_Stop)
+            return;
+         file = m_Requests.front();
+         m_Requests.pop_front();
+      }
+
+      int width, height, channels;
+      unsigned char* image = stbi_load(file.c_str(), &width, &height, &channels, STBI_rgb);
+      if (!image) {
+         std::cerr << "Failed to load texture: " << file << std::endl;
+         continue;
+      }
+
+      DecodedTexture texture;
+      texture.file = file;
+      texture.width = width;
+      texture.height = height;
+      texture.pixels.assign(image, image + size_t(width) * height * 3);
+      stbi_image_free(image);
+
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Ready.push_back(std::move(texture));
+   }
+}
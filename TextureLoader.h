@@ -0,0 +1,51 @@
+//
+//  TextureLoader.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_TextureLoader_h
+#define UserPerspectiveAR_TextureLoader_h
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// RGB pixels of an image file, ready to be uploaded
+struct DecodedTexture {
+   std::string                file;
+   int                        width;
+   int                        height;
+   std::vector<unsigned char> pixels;
+
+   DecodedTexture() : width(0), height(0) {}
+};
+
+// Decodes texture files in a background thread, so that the render loop
+// only has to upload them (see ArUco::uploadPendingTexture)
+class TextureLoader {
+public:
+   TextureLoader();
+   ~TextureLoader();
+
+   // Queues a file to decode
+   void     request(const std::string& file);
+
+   // Takes a decoded texture, false when none is ready (never blocks)
+   bool     take(DecodedTexture& texture);
+
+private:
+   void     run();
+
+   std::thread                m_Thread;
+   std::mutex                 m_Mutex;
+   std::condition_variable    m_Cond;
+   std::deque<std::string>    m_Requests;
+   std::deque<DecodedTexture> m_Ready;
+   bool                       m_Stop;
+};
+
+#endif
@@ -0,0 +1,109 @@
+//
+//  ThreadPool.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Pool and index of the worker running on this thread
+static thread_local const ThreadPool* t_Pool = NULL;
+static thread_local int t_Worker = -1;
+
+ThreadPool::ThreadPool(int threads) {
+   if (threads <= 0)
+      threads = max(1, int(thread::hardware_concurrency()));
+   m_Queued = 0;
+   m_Pending = 0;
+   m_NextQueue = 0;
+   m_Stop = false;
+   for (int i = 0; i < threads; i++)
+      m_Queues.push_back(unique_ptr<Queue>(new Queue()));
+   for (int i = 0; i < threads; i++)
+      m_Threads.push_back(thread(&ThreadPool::run, this, i));
+}
+
+ThreadPool::~ThreadPool() {
+   // queued tasks are run before the workers leave
+   {
+      lock_guard<mutex> lock(m_Mutex);
+      m_Stop = true;
+   }
+   m_Wake.notify_all();
+   for (size_t i = 0; i < m_Threads.size(); i++)
+      m_Threads[i].join();
+}
+
+int ThreadPool::currentWorker() const {
+   return t_Pool == this ? t_Worker : -1;
+}
+
+void ThreadPool::submit(function<void()> task) {
+   m_Pending++;
+   int worker = currentWorker();
+   Queue& queue = *m_Queues[worker >= 0 ? worker : m_NextQueue++ % m_Queues.size()];
+   {
+      lock_guard<mutex> lock(queue.mutex);
+      queue.tasks.push_back(move(task));
+   }
+   {
+      lock_guard<mutex> lock(m_Mutex);
+      m_Queued++;
+   }
+   m_Wake.notify_one();
+}
+
+void ThreadPool::wait() {
+   unique_lock<mutex> lock(m_Mutex);
+   m_Done.wait(lock, [this] { return m_Pending == 0; });
+}
+
+bool ThreadPool::takeTask(int worker, function<void()>& task) {
+   // newest task of our own queue: its data is likely still in cache
+   {
+      Queue& own = *m_Queues[worker];
+      lock_guard<mutex> lock(own.mutex);
+      if (!own.tasks.empty()) {
+         task = move(own.tasks.back());
+         own.tasks.pop_back();
+         m_Queued--;
+         return true;
+      }
+   }
+   // oldest task of another queue
+   for (size_t k = 1; k < m_Queues.size(); k++) {
+      Queue& other = *m_Queues[(worker + k) % m_Queues.size()];
+      lock_guard<mutex> lock(other.mutex);
+      if (!other.tasks.empty()) {
+         task = move(other.tasks.front());
+         other.tasks.pop_front();
+         m_Queued--;
+         return true;
+      }
+   }
+   return false;
+}
+
+void ThreadPool::run(int worker) {
+   t_Pool = this;
+   t_Worker = worker;
+   function<void()> task;
+   for (;;) {
+      if (takeTask(worker, task)) {
+         task();
+         task = nullptr;
+         if (--m_Pending == 0) {
+            lock_guard<mutex> lock(m_Mutex);
+            m_Done.notify_all();
+         }
+         continue;
+      }
+
+      unique_lock<mutex> lock(m_Mutex);
+      m_Wake.wait(lock, [this] { return m_Stop || m_Queued > 0; });
+      if (m_Stop && m_Queued == 0)
+         return;
+   }
+}
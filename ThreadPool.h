@@ -0,0 +1,63 @@
+//
+//  ThreadPool.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_ThreadPool_h
+#define UserPerspectiveAR_ThreadPool_h
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Each worker has its own queue: tasks submitted from a
+// worker go to its queue and are run last in first out, tasks from other threads are
+// spread over the queues. An idle worker takes the oldest task of another queue.
+class ThreadPool {
+public:
+   // 0 threads uses one per hardware thread
+   explicit ThreadPool(int threads = 0);
+   ~ThreadPool();
+
+   int   size() const { return int(m_Threads.size()); }
+
+   void  submit(std::function<void()> task);
+   // Returns when every task submitted so far (and the tasks they submitted) has run
+   void  wait();
+
+   // Index of the worker running the caller, -1 outside this pool
+   int   currentWorker() const;
+
+private:
+   ThreadPool(const ThreadPool&);
+   ThreadPool& operator=(const ThreadPool&);
+
+   struct Queue {
+      std::mutex                          mutex;
+      std::deque<std::function<void()> >  tasks;
+   };
+
+   bool  takeTask(int worker, std::function<void()>& task);
+   void  run(int worker);
+
+   std::vector<std::unique_ptr<Queue> > m_Queues;
+   std::vector<std::thread>   m_Threads;
+
+   std::mutex                 m_Mutex;
+   std::condition_variable    m_Wake;
+   std::condition_variable    m_Done;
+   // tasks in the queues (changed under m_Mutex when it grows, so that no wake up is lost)
+   std::atomic<int>           m_Queued;
+   // tasks queued or running
+   std::atomic<int>           m_Pending;
+   std::atomic<unsigned>      m_NextQueue;
+   bool                       m_Stop;
+};
+
+#endif
@@ -0,0 +1,99 @@
+//
+//  TileDiff.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#include "TileDiff.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+
+// Sum of n bytes
+static inline unsigned sumBytes(const uchar* p, int n) {
+   unsigned sum = 0;
+   int i = 0;
+#ifdef ARUCO_SSE2
+   const __m128i zero = _mm_setzero_si128();
+   __m128i acc = zero;
+   for (; i + 16 <= n; i += 16)
+      acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(p + i)), zero));
+   sum = unsigned(_mm_cvtsi128_si32(acc)) + unsigned(_mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#endif
+   for (; i < n; i++)
+      sum += p[i];
+   return sum;
+}
+
+TileChangeMap::TileChangeMap() {
+   m_TileSize = 32;
+   m_Type = -1;
+   m_TilesX = m_TilesY = 0;
+   m_Comparable = false;
+}
+
+void TileChangeMap::setTileSize(int tileSize) {
+   m_TileSize = std::max(1, tileSize);
+   m_Comparable = false;
+   m_Type = -1;
+}
+
+bool TileChangeMap::update(const cv::Mat& image) {
+   m_Comparable = (image.size() == m_ImageSize && image.type() == m_Type);
+   m_ImageSize = image.size();
+   m_Type = image.type();
+   m_TilesX = (image.cols + m_TileSize - 1) / m_TileSize;
+   m_TilesY = (image.rows + m_TileSize - 1) / m_TileSize;
+
+   m_Means.swap(m_PrevMeans);
+   m_Means.resize(m_TilesX * m_TilesY);
+   m_Sums.resize(m_TilesX);
+
+   const int cn = image.channels();
+   const int rowBytes = image.cols * cn;
+   const int tileBytes = m_TileSize * cn;
+
+   for (int ty = 0; ty < m_TilesY; ty++) {
+      int y0 = ty * m_TileSize;
+      int y1 = std::min(image.rows, y0 + m_TileSize);
+      std::fill(m_Sums.begin(), m_Sums.end(), 0u);
+
+      for (int y = y0; y < y1; y++) {
+         const uchar* row = image.ptr<uchar>(y);
+         for (int tx = 0; tx < m_TilesX; tx++) {
+            int start = tx * tileBytes;
+            m_Sums[tx] += sumBytes(row + start, std::min(tileBytes, rowBytes - start));
+         }
+      }
+
+      for (int tx = 0; tx < m_TilesX; tx++) {
+         int width = std::min(tileBytes, rowBytes - tx * tileBytes);
+         m_Means[ty * m_TilesX + tx] = float(m_Sums[tx]) / float(width * (y1 - y0));
+      }
+   }
+   return m_Comparable;
+}
+
+cv::Rect TileChangeMap::changedRegion(float threshold) const {
+   if (!m_Comparable)
+      return cv::Rect(0, 0, m_ImageSize.width, m_ImageSize.height);
+
+   int minX = m_TilesX, minY = m_TilesY, maxX = -1, maxY = -1;
+   for (int ty = 0; ty < m_TilesY; ty++) {
+      for (int tx = 0; tx < m_TilesX; tx++) {
+         int i = ty * m_TilesX + tx;
+         if (std::fabs(m_Means[i] - m_PrevMeans[i]) > threshold) {
+            minX = std::min(minX, tx);
+            maxX = std::max(maxX, tx);
+            minY = std::min(minY, ty);
+            maxY = std::max(maxY, ty);
+         }
+      }
+   }
+   if (maxX < 0)
+      return cv::Rect();
+
+   cv::Rect region(minX * m_TileSize, minY * m_TileSize,
+                   (maxX - minX + 1) * m_TileSize, (maxY - minY + 1) * m_TileSize);
+   return region & cv::Rect(0, 0, m_ImageSize.width, m_ImageSize.height);
+}
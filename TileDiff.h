@@ -0,0 +1,42 @@
+//
+//  TileDiff.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_TileDiff_h
+#define UserPerspectiveAR_TileDiff_h
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+// Low resolution difference map between consecutive frames.
+// Each frame is reduced to the mean intensity of its tiles (SSE2 sums of absolute values),
+// a tile "changed" when its mean moved by more than a threshold since the previous frame.
+class TileChangeMap {
+public:
+   TileChangeMap();
+
+   // Tile side in pixels (a multiple of 16 keeps the rows on whole SIMD blocks)
+   void     setTileSize(int tileSize);
+
+   // Reduces an 8 bit image to its tile means and compares them with the previous ones.
+   // Returns false when there is nothing to compare with (first frame, new size or type).
+   bool     update(const cv::Mat& image);
+
+   // Bounding box, in pixels, of the tiles whose mean changed by more than threshold grey levels
+   cv::Rect changedRegion(float threshold) const;
+
+private:
+   int                  m_TileSize;
+   cv::Size             m_ImageSize;
+   int                  m_Type;
+   int                  m_TilesX, m_TilesY;
+   bool                 m_Comparable;
+
+   std::vector<float>   m_Means;
+   std::vector<float>   m_PrevMeans;
+   std::vector<unsigned> m_Sums;
+};
+
+#endif
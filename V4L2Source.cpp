@@ -0,0 +1,267 @@
+//
+//  V4L2Source.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifdef __linux__
+
+#include "V4L2Source.h"
+#include "JpegDecode.h"
+#include "SimClock.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <linux/videodev2.h>
+
+using namespace std;
+
+// ioctl restarted when interrupted by a signal
+static int xioctl(int fd, unsigned long request, void* arg) {
+   int result;
+   do {
+      result = ioctl(fd, request, arg);
+   } while (result < 0 && errno == EINTR);
+   return result;
+}
+
+V4L2Source::V4L2Source() {
+   m_Fd = -1;
+   m_Format = V4L2_FORMAT_YUYV;
+   m_Stride = 0;
+   m_LumaOnly = false;
+   m_Running = false;
+   m_Latest = m_Held = -1;
+   m_Dropped = 0;
+}
+
+V4L2Source::~V4L2Source() {
+   release();
+}
+
+bool V4L2Source::open(const string& device, V4L2Format format, cv::Size size, int bufferCount) {
+   release();
+   m_Fd = ::open(device.c_str(), O_RDWR | O_NONBLOCK);
+   if (m_Fd < 0) {
+      LOG_ERROR("Cannot open %s: %s", device.c_str(), strerror(errno));
+      return false;
+   }
+
+   v4l2_capability capability = {};
+   if (xioctl(m_Fd, VIDIOC_QUERYCAP, &capability) < 0 || !(capability.capabilities & V4L2_CAP_VIDEO_CAPTURE) ||
+       !(capability.capabilities & V4L2_CAP_STREAMING)) {
+      LOG_ERROR("%s is not a streaming capture device", device.c_str());
+      release();
+      return false;
+   }
+
+   // Format: the driver answers with what it can actually do
+   const uint32_t fourccs[] = { V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_MJPEG, V4L2_PIX_FMT_GREY };
+   v4l2_format fmt = {};
+   fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+   xioctl(m_Fd, VIDIOC_G_FMT, &fmt);
+   if (size.area() > 0) {
+      fmt.fmt.pix.width = size.width;
+      fmt.fmt.pix.height = size.height;
+   }
+   fmt.fmt.pix.pixelformat = fourccs[format];
+   fmt.fmt.pix.field = V4L2_FIELD_NONE;
+   if (xioctl(m_Fd, VIDIOC_S_FMT, &fmt) < 0 || fmt.fmt.pix.pixelformat != fourccs[format]) {
+      LOG_ERROR("%s cannot deliver the requested pixel format", device.c_str());
+      release();
+      return false;
+   }
+   m_Format = format;
+   m_Size = cv::Size(fmt.fmt.pix.width, fmt.fmt.pix.height);
+   m_Stride = fmt.fmt.pix.bytesperline;
+
+   // Buffers allocated by the driver and mapped here. One is kept by read(), one waits
+   // to be read, the driver needs at least one more to keep capturing.
+   v4l2_requestbuffers request = {};
+   request.count = max(bufferCount, 3);
+   request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+   request.memory = V4L2_MEMORY_MMAP;
+   if (xioctl(m_Fd, VIDIOC_REQBUFS, &request) < 0 || request.count < 3) {
+      LOG_ERROR("%s cannot allocate capture buffers", device.c_str());
+      release();
+      return false;
+   }
+   for (uint32_t i = 0; i < request.count; i++) {
+      v4l2_buffer buffer = {};
+      buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      buffer.memory = V4L2_MEMORY_MMAP;
+      buffer.index = i;
+      if (xioctl(m_Fd, VIDIOC_QUERYBUF, &buffer) < 0) {
+         release();
+         return false;
+      }
+      Buffer mapped = {};
+      mapped.length = buffer.length;
+      mapped.data = mmap(NULL, buffer.length, PROT_READ | PROT_WRITE, MAP_SHARED, m_Fd, buffer.m.offset);
+      if (mapped.data == MAP_FAILED) {
+         LOG_ERROR("Cannot map the buffers of %s", device.c_str());
+         release();
+         return false;
+      }
+      m_Buffers.push_back(mapped);
+   }
+
+   for (size_t i = 0; i < m_Buffers.size(); i++)
+      queueBuffer(int(i));
+   v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+   if (xioctl(m_Fd, VIDIOC_STREAMON, &type) < 0) {
+      LOG_ERROR("Cannot start %s", device.c_str());
+      release();
+      return false;
+   }
+
+   m_Running = true;
+   m_Thread = thread(&V4L2Source::dequeueLoop, this);
+   LOG_INFO("%s: %dx%d, %d buffers", device.c_str(), m_Size.width, m_Size.height, int(m_Buffers.size()));
+   return true;
+}
+
+void V4L2Source::release() {
+   m_Running = false;
+   if (m_Thread.joinable())
+      m_Thread.join();
+
+   if (m_Fd >= 0) {
+      v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      xioctl(m_Fd, VIDIOC_STREAMOFF, &type);
+   }
+   for (size_t i = 0; i < m_Buffers.size(); i++)
+      munmap(m_Buffers[i].data, m_Buffers[i].length);
+   m_Buffers.clear();
+   if (m_Fd >= 0) {
+      // frees the driver's buffers
+      v4l2_requestbuffers request = {};
+      request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      request.memory = V4L2_MEMORY_MMAP;
+      xioctl(m_Fd, VIDIOC_REQBUFS, &request);
+      ::close(m_Fd);
+   }
+   m_Fd = -1;
+   m_Latest = m_Held = -1;
+   m_Decoded.release();
+}
+
+bool V4L2Source::isOpened() const {
+   return m_Fd >= 0;
+}
+
+bool V4L2Source::queueBuffer(int index) {
+   v4l2_buffer buffer = {};
+   buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+   buffer.memory = V4L2_MEMORY_MMAP;
+   buffer.index = index;
+   return xioctl(m_Fd, VIDIOC_QBUF, &buffer) == 0;
+}
+
+void V4L2Source::dequeueLoop() {
+   while (m_Running) {
+      pollfd fd = { m_Fd, POLLIN, 0 };
+      if (poll(&fd, 1, 100) <= 0)
+         continue;
+
+      v4l2_buffer buffer = {};
+      buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      buffer.memory = V4L2_MEMORY_MMAP;
+      if (xioctl(m_Fd, VIDIOC_DQBUF, &buffer) < 0) {
+         if (errno != EAGAIN)
+            LOG_WARNING_EVERY(1.0, "VIDIOC_DQBUF failed: %s", strerror(errno));
+         continue;
+      }
+
+      // Capture time from the driver when it uses the monotonic clock
+      Buffer& dequeued = m_Buffers[buffer.index];
+      dequeued.bytesUsed = buffer.bytesused;
+      if ((buffer.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+         dequeued.timestampNs = int64_t(buffer.timestamp.tv_sec) * 1000000000 + int64_t(buffer.timestamp.tv_usec) * 1000;
+      else
+         dequeued.timestampNs = monotonicNanoseconds();
+
+      // Only the newest frame matters: the one not read yet goes back to the driver
+      {
+         lock_guard<mutex> lock(m_Mutex);
+         if (m_Latest >= 0) {
+            queueBuffer(m_Latest);
+            m_Dropped++;
+         }
+         m_Latest = int(buffer.index);
+      }
+      m_Ready.notify_one();
+   }
+}
+
+bool V4L2Source::read(cv::Mat& frame, int64_t& timestampNs) {
+   if (m_Fd < 0)
+      return false;
+
+   int index;
+   {
+      unique_lock<mutex> lock(m_Mutex);
+      // the previous frame is no longer used
+      if (m_Held >= 0)
+         queueBuffer(m_Held);
+      m_Held = -1;
+      frame.release();
+      if (!m_Ready.wait_for(lock, chrono::seconds(2), [this] { return m_Latest >= 0; })) {
+         LOG_WARNING("No frame from the camera for 2 s");
+         return false;
+      }
+      index = m_Held = m_Latest;
+      m_Latest = -1;
+   }
+
+   Buffer& buffer = m_Buffers[index];
+   timestampNs = buffer.timestampNs;
+   switch (m_Format) {
+   case V4L2_FORMAT_YUYV:
+      frame = cv::Mat(m_Size, CV_8UC2, buffer.data, m_Stride);
+      break;
+   case V4L2_FORMAT_GREY:
+      frame = cv::Mat(m_Size, CV_8UC1, buffer.data, m_Stride);
+      break;
+   case V4L2_FORMAT_MJPEG:
+      // decoded directly at the smallest scale that is still large enough,
+      // the compressed buffer is not needed afterwards
+      decodeJpeg(buffer.data, buffer.bytesUsed, jpegScaleFor(m_Size, m_TargetSize), m_LumaOnly, m_Decoded);
+      frame = m_Decoded;
+      {
+         lock_guard<mutex> lock(m_Mutex);
+         queueBuffer(index);
+         m_Held = -1;
+      }
+      break;
+   }
+   return !frame.empty();
+}
+
+cv::Size V4L2Source::frameSize() const {
+   return m_Size;
+}
+
+PixelFormat V4L2Source::pixelFormat(const cv::Mat& /*frame*/) const {
+   switch (m_Format) {
+   case V4L2_FORMAT_YUYV: return PIXEL_FORMAT_YUYV;
+   case V4L2_FORMAT_GREY: return PIXEL_FORMAT_GREY;
+   default:               return m_LumaOnly ? PIXEL_FORMAT_GREY : PIXEL_FORMAT_BGR;
+   }
+}
+
+void V4L2Source::setTargetSize(cv::Size size) {
+   m_TargetSize = size;
+}
+
+void V4L2Source::setLumaOnly(bool lumaOnly) {
+   m_LumaOnly = lumaOnly;
+}
+
+#endif
@@ -0,0 +1,91 @@
+//
+//  V4L2Source.h
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+#ifndef UserPerspectiveAR_V4L2Source_h
+#define UserPerspectiveAR_V4L2Source_h
+
+#ifdef __linux__
+
+#include "FrameSource.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Formats a V4L2 camera can be asked for
+enum V4L2Format {
+   V4L2_FORMAT_YUYV,    // packed 4:2:2, returned as is (CV_8UC2)
+   V4L2_FORMAT_MJPEG,   // decoded to BGR, or to luma only, at the smallest JPEG scale covering the target size
+   V4L2_FORMAT_GREY     // luma only (CV_8UC1)
+};
+
+// Linux camera read straight from V4L2, without VideoCapture's conversion and copies.
+// The driver fills mmap'ed buffers that a thread dequeues as they arrive; read() returns
+// the newest one as a view (YUYV, GREY) and hands it back to the driver on the next read().
+// Frames are stamped with the driver's capture time.
+class V4L2Source : public FrameSource {
+public:
+   V4L2Source();
+   ~V4L2Source();
+
+   // size (0, 0) keeps the device's current size. The driver may pick another size or
+   // buffer count, see frameSize().
+   bool        open(const std::string& device, V4L2Format format = V4L2_FORMAT_YUYV,
+                    cv::Size size = cv::Size(), int bufferCount = 4);
+   void        release();
+   bool        isOpened() const;
+
+   bool        read(cv::Mat& frame, int64_t& timestampNs);
+   cv::Size    frameSize() const;
+   PixelFormat pixelFormat(const cv::Mat& frame) const;
+   void        setTargetSize(cv::Size size);
+
+   // MJPEG frames are decoded to their luma only (CV_8UC1), for the detector
+   void        setLumaOnly(bool lumaOnly);
+
+   int         bufferCount() const { return int(m_Buffers.size()); }
+   // Frames the driver delivered that read() never returned
+   uint64_t    droppedFrames() const { return m_Dropped; }
+
+private:
+   V4L2Source(const V4L2Source&);
+   V4L2Source& operator=(const V4L2Source&);
+
+   struct Buffer {
+      void*    data;
+      size_t   length;
+      size_t   bytesUsed;
+      int64_t  timestampNs;
+   };
+
+   void        dequeueLoop();
+   bool        queueBuffer(int index);
+
+   int                  m_Fd;
+   V4L2Format           m_Format;
+   cv::Size             m_Size;
+   cv::Size             m_TargetSize;
+   bool                 m_LumaOnly;
+   int                  m_Stride;
+   std::vector<Buffer>  m_Buffers;
+
+   std::thread          m_Thread;
+   std::atomic<bool>    m_Running;
+   std::mutex           m_Mutex;
+   std::condition_variable m_Ready;
+   // newest dequeued buffer not read yet, and the buffer behind the last frame returned
+   int                  m_Latest;
+   int                  m_Held;
+   uint64_t             m_Dropped;
+   cv::Mat              m_Decoded;
+};
+
+#endif
+
+#endif
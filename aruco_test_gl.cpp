@@ -45,19 +45,19 @@ using namespace cv;
 using namespace aruco;
 using namespace std;
 
-string TheInputVideo;
-string TheIntrinsicFile;
-bool The3DInfoAvailable = false;
-float TheMarkerSize = -1;
-MarkerDetector PPDetector;
-VideoCapture TheVideoCapturer;
-vector<Marker> TheMarkers;
-Mat TheInputImage, TheUndInputImage, TheResizedImage;
-CameraParameters TheCameraParams;
-Size TheGlWindowSize;
-GLFWwindow* window2;
-
-bool TheCaptureFlag = true;
+static string TheInputVideo;
+static string TheIntrinsicFile;
+static bool The3DInfoAvailable = false;
+static float TheMarkerSize = -1;
+static MarkerDetector PPDetector;
+static VideoCapture TheVideoCapturer;
+static vector<Marker> TheMarkers;
+static Mat TheInputImage, TheUndInputImage, TheResizedImage;
+static CameraParameters TheCameraParams;
+static Size TheGlWindowSize;
+static GLFWwindow* window2;
+
+static bool TheCaptureFlag = true;
 bool readIntrinsicFile(string TheIntrinsicFile, Mat& TheIntriscCameraMatrix, Mat& TheDistorsionCameraParams, Size size);
 
 void vDrawScene();
@@ -12,10 +12,48 @@
 
 // Main include
 #include "main.h"
+#include "BatchCli.h"
+#include "Benchmarks.h"
+#include "CameraRig.h"
+#include "Logger.h"
 #include <GLUT.h>
 #include <GL/GLU.h>
 
 
+AppOptions::AppOptions() {
+   lumaCapture = false;
+   staticCamera = false;
+   simStep = 0;
+   recordEncoding = SESSION_RAW;
+#ifdef __linux__
+   v4l2Format = V4L2_FORMAT_YUYV;
+   v4l2Buffers = 4;
+#endif
+   replayRealtime = false;
+   replayMarkers = false;
+   replayFrom = 0;
+   publishUdpPort = 0;
+}
+
+Application::Application() {
+   cameraID = 0;
+   source = NULL;
+   replay = NULL;
+   widthFrame = heightFrame = 0;
+   window = NULL;
+   arucoManager = NULL;
+}
+
+Application::~Application() {
+   exitFunction(*this);
+}
+
+// Application of a GLFW window
+static Application& application(GLFWwindow* window) {
+   return *static_cast<Application*>(glfwGetWindowUserPointer(window));
+}
+
+
 void error(int error, const char* description)
 {
     cout << "GLFW error code: " << error << ", description: " << description << endl;
@@ -23,16 +61,12 @@ void error(int error, const char* description)
 
 
 // Resize function
-void resize(GLFWwindow* window, GLsizei iWidth, GLsizei iHeight) {
+void resize(GLFWwindow* window, int iWidth, int iHeight) {
+    Application& app = application(window);
     // Calling ArUco resize
-    arucoManager->resize(iWidth, iHeight);
-
-    // not all sizes are allowed. OpenCV images have padding
-    // at the end of each line in these that are not aligned to 4 bytes
-    if (iWidth * 3 % 4 != 0) {
-        iWidth += iWidth * 3 % 4;//resize to avoid padding
-    }
-    glfwSetWindowSize(window, iWidth, iHeight);
+    app.arucoManager->resize(iWidth, iHeight);
+    // frames larger than the window are not needed
+    app.source->setTargetSize(cv::Size(iWidth, iHeight));
 }
 
 // Mouse function
@@ -46,8 +80,8 @@ void keyboard(GLFWwindow* window, int key, int scancode, int action, int mods) {
         switch (key) {
             case GLFW_KEY_ESCAPE:
             //case KEY_ESCAPE:
-            exitFunction();
-            exit(0);
+            // the render loop ends, main() releases everything
+            glfwSetWindowShouldClose(window, GLFW_TRUE);
             break;
 
         default:
@@ -56,53 +90,61 @@ void keyboard(GLFWwindow* window, int key, int scancode, int action, int mods) {
     }
 }
 
-// Loop function
-void doWork() {
-
-
+// Feeding the current frame to ArUco
+void processFrame(Application& app, const cv::Mat& frame) {
+    // Raw YUYV frames (CONVERT_RGB disabled) come as 2 channel images,
+    // frames from another process say what they are
+    app.arucoManager->idle(frame, app.source->pixelFormat(frame));
 }
 
-// Idle function
-void idle() {
+// Reading the next frame, quits at the end of a replay
+bool nextFrame(Application& app, cv::Mat& frame, int64_t& timestampNs) {
+    if (!app.source->read(frame, timestampNs)) {
+        if (app.replay) {
+            cout << "End of the session" << endl;
+            glfwSetWindowShouldClose(app.window, GLFW_TRUE);
+        }
+        return false;
+    }
 
-    // Clearing color and depth buffers
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // Showing the recorded markers, there may be no image to detect them on
+    if (app.replay && app.options.replayMarkers) {
+        vector<aruco::Marker> markers;
+        app.replay->markersAt(app.replay->position() - 1, markers, app.arucoManager->getMarkerSize());
+        app.arucoManager->setMarkers(markers, app.replay->frameSize());
+    }
+    return true;
+}
 
-    // Getting current frames
-    cap >> curImg;
-    if (curImg.empty())
+// Feeding a frame to ArUco unless its recorded markers are used
+static void detectFrame(Application& app, const cv::Mat& frame) {
+    if (frame.empty() || (app.replay && app.options.replayMarkers))
         return;
-
-    // Calling ArUco idle
-    arucoManager->idle(curImg);
-
-    // Keyboard manager + waiting for key
-    char retKey = cv::waitKey(1);
-    if (retKey == KEY_ESCAPE) {
-        exitFunction();
-        exit(EXIT_SUCCESS);
-    }
+    processFrame(app, frame);
 }
 
 
 // Initializing OpenGL/GLUt states
-void initGL(int argc, char * argv[]) {
+void initGL(Application& app) {
    
     glfwSetErrorCallback(error);
-    if (!glfwInit()) exitFunction();
+    if (!glfwInit())
+        return;
     //glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     //glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
     //glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     //glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     //glfwWindowHint(GLFW_DOUBLEBUFFER, GL_TRUE);
     //glfwWindowHint(GLFW_DEPTH_BITS, 24);
-    window = glfwCreateWindow(widthFrame, heightFrame,"ArUco", NULL, NULL);
+    app.window = glfwCreateWindow(app.widthFrame, app.heightFrame,"ArUco", NULL, NULL);
 
-   if (!window)
+   if (!app.window)
    {
        glfwTerminate();
-       exitFunction();
+       return;
    }
+   GLFWwindow* window = app.window;
+   glfwSetWindowUserPointer(window, &app);
 
    // Setting window's initial position
    glfwSetWindowPos(window, 200, 200);
@@ -128,65 +170,119 @@ void initGL(int argc, char * argv[]) {
    glCullFace(GL_BACK);
 
    // We make sure the webcam frame's size to match thatof the OpenGL's window
-   arucoManager->resize(widthFrame, heightFrame);
-   glfwSetWindowSize(window, widthFrame, heightFrame);
+   app.arucoManager->resize(app.widthFrame, app.heightFrame);
+   app.source->setTargetSize(cv::Size(app.widthFrame, app.heightFrame));
+   glfwSetWindowSize(window, app.widthFrame, app.heightFrame);
 
 
    // Reading a first webcam's frame to make sure  of their size
-   cap >> curImg;
+   int64_t captured;
+   nextFrame(app, app.curImg, captured);
    // and we scale the camara parameters to match the calibration file with the current resolution (they may be different)
-   arucoManager->resizeCameraParams(curImg.size());
+   app.arucoManager->resizeCameraParams(app.source->frameSize());
 
    // render loop
+   int64_t lastLoop = monotonicNanoseconds();
    while (!glfwWindowShouldClose(window))
    {
        // Getting current frame from the camera
-       cap >> curImg;
+       int64_t loopStart = monotonicNanoseconds();
+       if (!nextFrame(app, app.curImg, captured) && app.replay)
+           break;
+       int64_t read = monotonicNanoseconds();
 
        // Calling ArUco idle
-       arucoManager->idle(curImg);
+       detectFrame(app, app.curImg);
+       int64_t processed = monotonicNanoseconds();
+
+       // Handing the poses to the other processes before drawing
+       if (app.publisher.isOpen())
+           app.publisher.publish(app.arucoManager->getMarkers(), captured);
+
+       // Switching to the scene file when it was edited
+       SceneConfig reloaded;
+       if (app.sceneReloader.poll(reloaded))
+           app.arucoManager->setScene(reloaded);
 
        // Calling ArUco draw function
-       arucoManager->drawScene();
+       app.arucoManager->drawScene();
+
+       // Recording the frame, its markers and where the time went
+       if (app.recorder.isOpen()) {
+           float stageMs[SESSION_STAGES];
+           stageMs[STAGE_CAPTURE] = (read - loopStart) * 1e-6f;
+           stageMs[STAGE_PROCESS] = (processed - read) * 1e-6f;
+           stageMs[STAGE_DRAW] = (monotonicNanoseconds() - processed) * 1e-6f;
+           stageMs[STAGE_FRAME] = (loopStart - lastLoop) * 1e-6f;
+           app.recorder.record(app.curImg, captured, app.arucoManager->getMarkers(), stageMs);
+       }
+       lastLoop = loopStart;
 
        // check and call events and swap the buffers
        glfwPollEvents();
        glfwSwapBuffers(window);
 
-       // Showing images
-       imshow(windowNameCapture, curImg);
+       // Showing images (raw YUYV frames cannot be displayed by OpenCV)
+       if (!app.curImg.empty() && app.curImg.type() == CV_8UC3)
+           imshow(app.windowNameCapture, app.curImg);
 
        // Keyboard manager + waiting for key
        char retKey = cv::waitKey(1);
-       if (retKey == KEY_ESCAPE) {
-           exitFunction();
-           exit(EXIT_SUCCESS);
-       }
+       if (retKey == KEY_ESCAPE)
+           break;
    }
 }
 
 
 
 // Exit function
-void exitFunction() {  
+void exitFunction(Application& app) {  
    
    // Destroy OpenCV window
-   destroyWindow(windowNameCapture);
+   if (!app.windowNameCapture.empty())
+      destroyWindow(app.windowNameCapture);
+   app.windowNameCapture.clear();
    
    // Release capture
-   cap.release();
+   if (app.source) {
+      app.source->release();
+      if (app.source != app.replay)
+         delete app.source;
+      app.source = NULL;
+   }
+   delete app.replay;
+   app.replay = NULL;
+
+   app.sceneReloader.stop();
+   app.publisher.close();
+
+   // Writing the frames still queued
+   if (app.recorder.isOpen()) {
+      app.recorder.close();
+      cout << "Recorded frames: " << app.recorder.recordedFrames() << " (" << app.recorder.droppedFrames()
+           << " dropped, " << app.recorder.bytesWritten() / (1024 * 1024) << " MB)" << endl;
+   }
    
    // Deleting ArUco manager
-   if(arucoManager) {
-      delete(arucoManager);
-      arucoManager = NULL;
+   if(app.arucoManager) {
+      // How much CPU went to frames the camera delivered twice
+      const FrameDedupStats& dedup = app.arucoManager->getDedupStats();
+      cout << "Duplicate frames skipped: " << dedup.duplicates << " / " << dedup.frames
+           << " (saved ~" << dedup.savedTime() << " s, hashing cost " << dedup.hashTime << " s)" << endl;
+
+      delete(app.arucoManager);
+      app.arucoManager = NULL;
    }
    
-   // Deleting GLUT window
-   if(window) {
-      //glfwDestroyWindow(window);
+   // Deleting GLFW window
+   if(app.window) {
+      glfwDestroyWindow(app.window);
+      app.window = NULL;
+      glfwTerminate();
    }
-   
+
+   // Writing the last queued messages
+   Logger::instance().shutdown();
 }
 
 // Main 
@@ -202,42 +298,180 @@ int main(int argc, char * argv[])
    
    printf("Hot keys: \n"
           "\tESC - quit the program\n");
+
+   printf("Options: \n"
+          "\t--luma - grab raw YUYV frames and detect markers on the luma plane\n"
+          "\t         (with --v4l2-format mjpeg: decode the luma only)\n"
+          "\t--static-camera - only detect again where the image changed\n"
+          "\t--sim-step <seconds> - advance the animation by a fixed step per frame\n"
+          "\t--scene <file> - scene to display (default scene.yml), reloaded when saved\n"
+          "\t--record <file> - record frames, markers and timings to a session file\n"
+          "\t--record-png - compress the recorded frames (lossless)\n"
+          "\t--record-markers - record markers and timings only, no frames\n"
+          "\t--replay <file> - play a recorded session instead of the camera, as fast as possible\n"
+          "\t--replay-realtime - play the session at the speed it was recorded\n"
+          "\t--replay-markers - show the recorded markers instead of detecting them again\n"
+          "\t--replay-from <frame> - start the session at a given frame\n"
+#ifdef __linux__
+          "\t--v4l2 <device> - read the camera through V4L2 (e.g. /dev/video0)\n"
+          "\t--v4l2-format <yuyv|mjpeg|grey> - pixel format asked to the camera (default yuyv)\n"
+          "\t--v4l2-size <width>x<height> - frame size asked to the camera\n"
+          "\t--v4l2-buffers <n> - number of capture buffers (default 4)\n"
+#endif
+          "\t--shm-input <name> - read the frames another process writes in shared memory (see FrameShm.h)\n"
+          "\t--publish-shm <name> - publish the poses in shared memory (see PoseShm.h, e.g. /aruco_poses)\n"
+          "\t--publish-udp <port> - publish the poses as UDP datagrams on localhost\n"
+          "\t--rig <file> [seconds] - track the cameras of a rig file (see rig.yml) without display and\n"
+          "\t         print their throughput and latency (default 10 s)\n"
+          "\t--batch [options] <inputs>... - write the marker tracks of videos, image directories or\n"
+          "\t         session files without display (--batch alone lists its options)\n"
+          "\t--bench <name> [file] - run a benchmark and quit (ordering, detection, synth, render, replay, jpeg, batch)\n");
+
+   // Everything the application uses, released when main() returns
+   Application app;
+   AppOptions& options = app.options;
+
+   for (int i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "--batch") == 0)
+         return batchMain(argc - i - 1, argv + i + 1);
+      else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+         return runBenchmark(argv[i + 1], i + 2 < argc ? argv[i + 2] : "");
+      else if (strcmp(argv[i], "--rig") == 0 && i + 1 < argc)
+         return runCameraRig(argv[i + 1], i + 2 < argc ? atof(argv[i + 2]) : 10.0);
+      else if (strcmp(argv[i], "--luma") == 0)
+         options.lumaCapture = true;
+      else if (strcmp(argv[i], "--static-camera") == 0)
+         options.staticCamera = true;
+      else if (strcmp(argv[i], "--sim-step") == 0 && i + 1 < argc)
+         options.simStep = atof(argv[++i]);
+      else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+         options.sceneFile = argv[++i];
+      else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+         options.recordFile = argv[++i];
+      else if (strcmp(argv[i], "--record-png") == 0)
+         options.recordEncoding = SESSION_PNG;
+      else if (strcmp(argv[i], "--record-markers") == 0)
+         options.recordEncoding = SESSION_NO_IMAGE;
+      else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+         options.replayFile = argv[++i];
+      else if (strcmp(argv[i], "--replay-realtime") == 0)
+         options.replayRealtime = true;
+      else if (strcmp(argv[i], "--replay-markers") == 0)
+         options.replayMarkers = true;
+      else if (strcmp(argv[i], "--replay-from") == 0 && i + 1 < argc)
+         options.replayFrom = atol(argv[++i]);
+#ifdef __linux__
+      else if (strcmp(argv[i], "--v4l2") == 0 && i + 1 < argc)
+         options.v4l2Device = argv[++i];
+      else if (strcmp(argv[i], "--v4l2-format") == 0 && i + 1 < argc) {
+         i++;
+         options.v4l2Format = strcmp(argv[i], "mjpeg") == 0 ? V4L2_FORMAT_MJPEG
+                    : strcmp(argv[i], "grey") == 0 ? V4L2_FORMAT_GREY : V4L2_FORMAT_YUYV;
+      }
+      else if (strcmp(argv[i], "--v4l2-size") == 0 && i + 1 < argc)
+         sscanf(argv[++i], "%dx%d", &options.v4l2Size.width, &options.v4l2Size.height);
+      else if (strcmp(argv[i], "--v4l2-buffers") == 0 && i + 1 < argc)
+         options.v4l2Buffers = atoi(argv[++i]);
+#endif
+      else if (strcmp(argv[i], "--shm-input") == 0 && i + 1 < argc)
+         options.shmInputName = argv[++i];
+      else if (strcmp(argv[i], "--publish-shm") == 0 && i + 1 < argc)
+         options.publishShmName = argv[++i];
+      else if (strcmp(argv[i], "--publish-udp") == 0 && i + 1 < argc)
+         options.publishUdpPort = atoi(argv[++i]);
+   }
+
+   // Loading the scene (the built-in solar system if there is no scene file)
+   if (options.sceneFile.empty())
+      options.sceneFile = "scene.yml";
+   SceneConfig scene = defaultSceneConfig();
+   if (!loadScene(options.sceneFile, scene))
+      cerr << "Could not load the scene " << options.sceneFile << ", using the default one" << endl;
    
    // Creating the ArUco object
-   arucoManager = new ArUco("camera.yml", 0.105f);
+   app.arucoManager = new ArUco(scene.cameraFile, scene.markerSize);
+   app.arucoManager->setScene(scene);
+   app.sceneReloader.start(options.sceneFile);
+   if (!options.recordFile.empty() && app.recorder.open(options.recordFile, options.recordEncoding))
+      cout << "Recording to " << options.recordFile << endl;
+   if (!options.publishShmName.empty() && app.publisher.openSharedMemory(options.publishShmName))
+      cout << "Publishing poses in " << options.publishShmName << endl;
+   if (options.publishUdpPort > 0 && app.publisher.openUdp(options.publishUdpPort))
+      cout << "Publishing poses to udp://127.0.0.1:" << options.publishUdpPort << endl;
+   if (options.staticCamera)
+      app.arucoManager->setChangeDrivenDetection(true);
+   if (options.simStep > 0)
+      app.arucoManager->getClock().setFixedStep(options.simStep);
    std::cout<<"ArUco OK"<<std::endl;
    
-   // Creating the OpenCV capture
-   cout << "Entrez l'identifiant de la camera" << endl;
-   cin >> cameraID;
-   cap.open(cameraID);
-   if(!cap.isOpened()) {
-      cerr << "Erreur lors de l'initialisation de la capture de la camera !"<< endl;
-      cerr << "Fermeture..." << endl;
-      exit(EXIT_FAILURE);
+   // Playing a recorded session instead of the camera
+   if (!options.replayFile.empty()) {
+      app.replay = new SessionReplay();
+      if (!app.replay->open(options.replayFile) || app.replay->frameCount() == 0) {
+         cerr << "Cannot replay " << options.replayFile << endl;
+         return EXIT_FAILURE;
+      }
+      if (options.replayFrom > 0 && !app.replay->seek(options.replayFrom))
+         cerr << "The session only has " << app.replay->frameCount() << " frames" << endl;
+      app.replay->setRealtime(options.replayRealtime);
+      app.source = app.replay;
+      cout << "Replaying " << app.replay->frameCount() << " frames from " << options.replayFile << endl;
+   }
+   else if (!options.shmInputName.empty()) {
+      // Frames written by the acquisition process
+      ShmFrameSource* shmSource = new ShmFrameSource();
+      if (!shmSource->open(options.shmInputName)) {
+         cerr << "Cannot read frames from " << options.shmInputName << endl;
+         return EXIT_FAILURE;
+      }
+      app.source = shmSource;
+      cout << "Reading frames from " << options.shmInputName << endl;
    }
-   else{
-      // retrieving a first frame so that the display does not crash
-      cap >> curImg;
+#ifdef __linux__
+   else if (!options.v4l2Device.empty()) {
+      V4L2Source* camera = new V4L2Source();
+      if (!camera->open(options.v4l2Device, options.v4l2Format, options.v4l2Size, options.v4l2Buffers)) {
+         cerr << "Erreur lors de l'initialisation de la capture de la camera !" << endl;
+         return EXIT_FAILURE;
+      }
+      camera->setLumaOnly(options.lumaCapture);
+      app.source = camera;
+   }
+#endif
+   else {
+      // Creating the OpenCV capture
+      cout << "Entrez l'identifiant de la camera" << endl;
+      cin >> app.cameraID;
+      app.cap.open(app.cameraID);
+      if(!app.cap.isOpened()) {
+         cerr << "Erreur lors de l'initialisation de la capture de la camera !"<< endl;
+         cerr << "Fermeture..." << endl;
+         return EXIT_FAILURE;
+      }
+      else{
+         if (options.lumaCapture) {
+            // keep the camera's YUYV buffers instead of letting OpenCV convert them to BGR
+            app.cap.set(cv::CAP_PROP_FOURCC, VideoWriter::fourcc('Y', 'U', 'Y', 'V'));
+            app.cap.set(cv::CAP_PROP_CONVERT_RGB, 0);
+         }
+         // retrieving a first frame so that the display does not crash
+         app.cap >> app.curImg;
+      }
+      app.source = new VideoCaptureSource(app.cap);
    }
    
    // Getting width/height of the image
-   widthFrame  = cap.get(cv::VideoCaptureProperties::CAP_PROP_FRAME_WIDTH);
-   heightFrame = cap.get(cv::VideoCaptureProperties::CAP_PROP_FRAME_HEIGHT);
-   std::cout<<"Frame width = "<<widthFrame<<std::endl;
-   std::cout<<"Frame height = "<<heightFrame<<std::endl;
+   app.widthFrame  = app.source->frameSize().width;
+   app.heightFrame = app.source->frameSize().height;
+   std::cout<<"Frame width = "<<app.widthFrame<<std::endl;
+   std::cout<<"Frame height = "<<app.heightFrame<<std::endl;
    
    // OpenCV window 
-   windowNameCapture = "Scene";
-   cv::namedWindow(windowNameCapture, WINDOW_AUTOSIZE);  
-   
-   // Exit function
-   atexit(exitFunction);
+   app.windowNameCapture = "Scene";
+   cv::namedWindow(app.windowNameCapture, WINDOW_AUTOSIZE);  
    
-   // OpenGL/GLUT Initialization
-   initGL(argc, argv);
-   
-
+   // OpenGL/GLUT Initialization, returns when the window is closed
+   initGL(app);
 
    return 0;
 }
@@ -28,6 +28,11 @@
 
 // ArUco
 #include "ArUco-OpenGL.h"
+#include "SessionRecorder.h"
+#include "SessionReplay.h"
+#include "ShmFrameSource.h"
+#include "V4L2Source.h"
+#include "PosePublisher.h"
 
 // Default wdth and height of the video
 #define DEFAULT_VIDEO_WIDTH   800
@@ -41,57 +46,114 @@
 using namespace std;
 using namespace cv;
 
-// OpenCV stuff: cameras, etc.
-int            cameraID;
-VideoCapture   cap;
+// Command line of the interactive application
+struct AppOptions {
+   // Asking the camera for raw YUYV frames so that detection runs on the luma plane
+   bool           lumaCapture;
 
-// Names of the OpenCV windows
-string         windowNameCapture;
+   // Fixed camera: markers are only searched again where the image changed
+   bool           staticCamera;
 
+   // Fixed animation step in seconds (0 follows the real time)
+   double         simStep;
 
-// Width/Height of the image
-int            widthFrame;
-int            heightFrame;
+   // Scene file, reloaded in the background when it is saved
+   std::string    sceneFile;
 
-// GLUT attributes
-GLint          g_hWindow;
-GLFWwindow*	   window;
+   // Session recording (--record)
+   std::string    recordFile;
+   SessionEncoding recordEncoding;
 
-// ArUco object
-ArUco          *arucoManager;
+   // Frames handed over by another process (--shm-input) instead of the camera
+   std::string    shmInputName;
 
-// Ratio of view resizing
-double         resizeRatio;
+#ifdef __linux__
+   // Camera read through V4L2 directly (--v4l2) instead of VideoCapture
+   std::string    v4l2Device;
+   V4L2Format     v4l2Format;
+   cv::Size       v4l2Size;
+   int            v4l2Buffers;
+#endif
 
-// Keeping current capture image
-cv::Mat        curImg;
+   // Session replay (--replay) instead of the camera
+   std::string    replayFile;
+   bool           replayRealtime;
+   // recorded markers are shown instead of detecting them again
+   bool           replayMarkers;
+   long           replayFrom;
 
-// Test again
-cv::Mat        debugImg;
+   // Poses sent to other processes (--publish-shm, --publish-udp)
+   std::string    publishShmName;
+   int            publishUdpPort;
 
-// Forward declarations
+   AppOptions();
+};
+
+// State of the running application. main() owns it, the GLFW callbacks reach it
+// through the user pointer of the window.
+struct Application {
+   AppOptions     options;
+
+   // OpenCV stuff: cameras, etc.
+   int            cameraID;
+   VideoCapture   cap;
+
+   // Where the frames come from: the camera or a replayed session
+   FrameSource    *source;
+   SessionReplay  *replay;
+
+   // Names of the OpenCV windows
+   string         windowNameCapture;
+
+   // Width/Height of the image
+   int            widthFrame;
+   int            heightFrame;
+
+   // GLFW window
+   GLFWwindow*    window;
 
-// GLUT functions
+   // ArUco object
+   ArUco          *arucoManager;
 
-// Initializing OpenGL
-void initGL(int argc, char * argv[]);
+   // Keeping current capture image
+   cv::Mat        curImg;
 
-// Loop function
-void doWork();
+   SceneReloader  sceneReloader;
+   SessionRecorder recorder;
+   PosePublisher  publisher;
 
-// Idle function
-void idle();
+   Application();
+   // Releases everything (exit function)
+   ~Application();
+
+private:
+   Application(const Application&);
+   Application& operator=(const Application&);
+};
+
+// Forward declarations
+
+// GLFW functions
+
+// Initializing OpenGL and running the render loop until the window is closed
+void initGL(Application& app);
 
 // Resize function
-void resize(GLsizei iWidth, GLsizei iHeight);
+void resize(GLFWwindow* window, int iWidth, int iHeight);
 
 // Mouse function
-void mouse(int b,int s,int x,int y);
+void mouse(GLFWwindow* window, double x, double y);
 
 // Keyboard function
-void keyboard(unsigned char key, int x, int y);
+void keyboard(GLFWwindow* window, int key, int scancode, int action, int mods);
 
 // Exit function
-void exitFunction();
+void exitFunction(Application& app);
+
+// Feeding the current frame to ArUco in the format the camera delivered it
+void processFrame(Application& app, const cv::Mat& frame);
+
+// Reading the next frame, false at the end of the source (a replay asks the window to close)
+bool nextFrame(Application& app, cv::Mat& frame, int64_t& timestampNs);
 
 #endif
@@ -0,0 +1,110 @@
+//
+//  frame_dedup_test.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+// Two different frames with the same fingerprint (they only differ outside the bytes
+// frameFingerprint() samples) must each get their own markers from the batch mode and
+// from DetectionEngine::detectBatch().
+//
+//    frame_dedup_test <work directory>
+//
+// Run from the source directory, for scene.yml and camera.yml.
+
+#include "../BatchCli.h"
+#include "../DetectionEngine.h"
+#include "../FrameHash.h"
+#include "../ThreadPool.h"
+#include "aruco/aruco.h"
+
+#include <opencv2/imgcodecs.hpp>
+#include <stdio.h>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static int failures = 0;
+
+#define CHECK(condition) \
+   do { if (!(condition)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); failures++; } } while (0)
+
+// White frame with a single marker. At 1600 pixels per grey row, the fingerprint samples
+// 16 bytes every 226, the marker (120 pixels from x = 70) lies between two of them.
+static cv::Mat markerFrame(aruco::Dictionary& dictionary, int id) {
+   cv::Mat frame(480, 1600, CV_8UC1, cv::Scalar(255));
+   cv::Mat marker = dictionary.getMarkerImage_id(id, 15, false);
+   cv::Mat area = frame(cv::Rect(70, 180, marker.cols, marker.rows));
+   marker.copyTo(area);
+   return frame;
+}
+
+// Ids found in each frame of a CSV track
+static bool readTrack(const string& file, set<int> ids[2]) {
+   FILE* track = fopen(file.c_str(), "r");
+   if (!track)
+      return false;
+   char line[1024];
+   bool header = true;
+   while (fgets(line, sizeof(line), track)) {
+      unsigned long long frame;
+      long long timestamp;
+      int id;
+      if (header) {
+         header = false;
+         continue;
+      }
+      if (sscanf(line, "%llu,%lld,%d", &frame, &timestamp, &id) == 3 && frame < 2)
+         ids[frame].insert(id);
+   }
+   fclose(track);
+   return true;
+}
+
+int main(int argc, char* argv[]) {
+   if (argc < 2) {
+      fprintf(stderr, "Usage: frame_dedup_test <work directory>\n");
+      return 1;
+   }
+   string work = argv[1];
+   string input = work + "/frames";
+
+   aruco::Dictionary dictionary = aruco::Dictionary::loadPredefined("ARUCO_MIP_36h12");
+   cv::Mat first = markerFrame(dictionary, 5);
+   cv::Mat second = markerFrame(dictionary, 7);
+   // otherwise the test does not exercise anything
+   CHECK(frameFingerprint(first) == frameFingerprint(second));
+   CHECK(cv::norm(first, second, cv::NORM_INF) != 0);
+
+   CHECK(cv::imwrite(input + "/0.png", first));
+   CHECK(cv::imwrite(input + "/1.png", second));
+
+   // a single worker detects both frames one after the other
+   string output = work;
+   char* batchArgs[] = { (char*)"--threads", (char*)"1", (char*)"-o", &output[0], &input[0] };
+   CHECK(batchMain(5, batchArgs) == 0);
+
+   set<int> ids[2];
+   CHECK(readTrack(work + "/frames.csv", ids));
+   CHECK(ids[0].size() == 1 && ids[0].count(5) == 1);
+   CHECK(ids[1].size() == 1 && ids[1].count(7) == 1);
+
+   // same with a batch of the engine, dedup being left on for the stream of the engine itself
+   ThreadPool pool(1);
+   DetectionEngine engine;
+   engine.setFrameDedup(true);
+   vector<cv::Mat> frames;
+   frames.push_back(first);
+   frames.push_back(second);
+   vector<FrameDetection> results;
+   engine.detectBatch(pool, frames, results, PIXEL_FORMAT_GREY);
+   CHECK(results.size() == 2);
+   CHECK(results.size() == 2 && results[0].markers.size() == 1 && results[0].markers[0].id == 5);
+   CHECK(results.size() == 2 && results[1].markers.size() == 1 && results[1].markers[0].id == 7);
+
+   if (failures == 0)
+      printf("frame_dedup_test: ok\n");
+   return failures == 0 ? 0 : 1;
+}
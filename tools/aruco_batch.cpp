@@ -0,0 +1,16 @@
+//
+//  aruco_batch.cpp
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+// Headless build of the batch mode (--batch of the application), for machines without
+// OpenGL. Takes the same options:
+//
+//    aruco_batch [options] <video|image directory|session file>...
+
+#include "../BatchCli.h"
+
+int main(int argc, char* argv[]) {
+   return batchMain(argc - 1, argv + 1);
+}
@@ -0,0 +1,146 @@
+//
+//  pose_subscriber.c
+//
+//  Copyright (c) 2021 Centrale Nantes. All rights reserved.
+//
+
+// Reads the poses published by the application (--publish-shm / --publish-udp) and
+// prints the publication latency: time between the write of a frame and its reception
+// here, and between the capture of the frame and its reception.
+//
+//    pose_subscriber [name]            shared memory (default /aruco_poses)
+//    pose_subscriber --udp [port]      UDP datagrams (default 47800)
+//
+// Build: cc -O2 -I.. pose_subscriber.c -o pose_subscriber (add -lrt on older glibc)
+
+#ifdef _WIN32
+#include <winsock2.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "../PoseShm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Latencies are reported every REPORT_FRAMES frames
+#define REPORT_FRAMES 500
+
+static int64_t publishLatency[REPORT_FRAMES];
+static int64_t captureLatency[REPORT_FRAMES];
+static int sampleCount;
+
+static int compareInt64(const void* a, const void* b) {
+   int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+   return x < y ? -1 : x > y;
+}
+
+static void printPercentiles(const char* name, int64_t* samples, int count) {
+   qsort(samples, count, sizeof(int64_t), compareInt64);
+   printf("%8s  p50 %8.1f  p90 %8.1f  p99 %8.1f  max %8.1f us\n", name, samples[count / 2] * 1e-3,
+          samples[count * 9 / 10] * 1e-3, samples[count * 99 / 100] * 1e-3, samples[count - 1] * 1e-3);
+}
+
+static void addSample(const PoseShmSlot* slot, int64_t received, uint64_t lost) {
+   publishLatency[sampleCount] = received - slot->publishNs;
+   captureLatency[sampleCount] = received - slot->captureNs;
+   if (++sampleCount < REPORT_FRAMES)
+      return;
+
+   printf("frame %llu, %u markers, %llu frames missed\n", (unsigned long long)slot->frameIndex,
+          slot->markerCount, (unsigned long long)lost);
+   printPercentiles("publish", publishLatency, sampleCount);
+   printPercentiles("capture", captureLatency, sampleCount);
+   fflush(stdout);
+   sampleCount = 0;
+}
+
+static int subscribeSharedMemory(const char* name) {
+   const PoseShmRegion* region;
+#ifdef _WIN32
+   HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name[0] == '/' ? name + 1 : name);
+   region = mapping ? (const PoseShmRegion*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(PoseShmRegion)) : NULL;
+   if (!region) {
+      fprintf(stderr, "Cannot open the shared memory %s\n", name);
+      return 1;
+   }
+#else
+   int fd = shm_open(name, O_RDONLY, 0);
+   if (fd < 0) {
+      fprintf(stderr, "Cannot open the shared memory %s\n", name);
+      return 1;
+   }
+   region = (const PoseShmRegion*)mmap(NULL, sizeof(PoseShmRegion), PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if (region == MAP_FAILED) {
+      fprintf(stderr, "Cannot map the shared memory %s\n", name);
+      return 1;
+   }
+#endif
+   if (pose_shm_load32(&region->magic) != POSE_SHM_MAGIC || region->version != POSE_SHM_VERSION) {
+      fprintf(stderr, "%s is not a pose region\n", name);
+      return 1;
+   }
+
+   // Busy polling: the lowest latency, at the price of a core
+   static PoseShmSlot slot;
+   uint64_t last = 0, lost = 0;
+   for (;;) {
+      if (pose_shm_load64(&region->latest) == last)
+         continue;
+      uint64_t latest = pose_shm_read_latest(region, &slot);
+      int64_t received = pose_shm_now_ns();
+      if (last != 0 && latest > last + 1)
+         lost += latest - last - 1;
+      last = latest;
+      addSample(&slot, received, lost);
+   }
+}
+
+static int subscribeUdp(int port) {
+#ifdef _WIN32
+   WSADATA wsa;
+   WSAStartup(MAKEWORD(2, 2), &wsa);
+   SOCKET s = socket(AF_INET, SOCK_DGRAM, 0);
+#else
+   int s = socket(AF_INET, SOCK_DGRAM, 0);
+#endif
+   struct sockaddr_in address;
+   memset(&address, 0, sizeof(address));
+   address.sin_family = AF_INET;
+   address.sin_port = htons((unsigned short)port);
+   address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   if (bind(s, (struct sockaddr*)&address, sizeof(address)) != 0) {
+      fprintf(stderr, "Cannot listen on port %d\n", port);
+      return 1;
+   }
+
+   static PoseShmSlot slot;
+   uint64_t last = 0, lost = 0;
+   int first = 1;
+   for (;;) {
+      int bytes = (int)recv(s, (char*)&slot, sizeof(slot), 0);
+      int64_t received = pose_shm_now_ns();
+      if (bytes < (int)POSE_SLOT_BYTES(0) || bytes != (int)POSE_SLOT_BYTES(slot.markerCount))
+         continue;
+      if (!first && slot.frameIndex > last + 1)
+         lost += slot.frameIndex - last - 1;
+      first = 0;
+      last = slot.frameIndex;
+      addSample(&slot, received, lost);
+   }
+}
+
+int main(int argc, char* argv[]) {
+   if (argc > 1 && strcmp(argv[1], "--udp") == 0)
+      return subscribeUdp(argc > 2 ? atoi(argv[2]) : POSE_UDP_DEFAULT_PORT);
+   return subscribeSharedMemory(argc > 1 ? argv[1] : POSE_SHM_DEFAULT_NAME);
+}